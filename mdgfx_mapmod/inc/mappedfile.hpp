@@ -0,0 +1,52 @@
+#ifndef MDMAPMOD__MAPPEDFILE_H
+#define MDMAPMOD__MAPPEDFILE_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <string>
+
+/**
+ * A file mapped into memory, so it can be edited in place without reading it
+ * in or writing it back out
+ * Changes to a writable mapping go straight to the file
+ */
+class MappedFile
+{
+public:
+	/**
+	 * Maps an existing file, either read only or for editing in place
+	 */
+	MappedFile(std::string const & path, bool writable);
+
+	/**
+	 * Creates (or truncates) a file of the given size and maps it for writing
+	 */
+	MappedFile(std::string const & path, std::size_t size);
+
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile & operator=(MappedFile const &) = delete;
+
+	u8 * data() const;
+
+	std::size_t size() const;
+
+	/**
+	 * Grows or shrinks a writable file (and its mapping), keeping the contents up
+	 * to the smaller of the two sizes
+	 * The data may move, so any pointers into it must be refreshed
+	 */
+	void resize(std::size_t size);
+
+private:
+	void map(int fd, bool writable);
+
+	void unmap();
+
+	std::string m_path;
+	u8 * m_data;
+	std::size_t m_size;
+};
+
+#endif
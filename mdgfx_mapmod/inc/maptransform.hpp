@@ -0,0 +1,64 @@
+#ifndef MDMAPMOD__MAPTRANSFORM_H
+#define MDMAPMOD__MAPTRANSFORM_H
+
+#include "common.hpp"
+#include <cstddef>
+
+// 2D transforms over a map of the given width and height, in entries
+// All of them work in place (entries in native byte order for those that
+// touch the flags)
+
+// an area of a map, in entries
+struct MapRect
+{
+	std::size_t x;
+	std::size_t y;
+	std::size_t width;
+	std::size_t height;
+};
+
+/**
+ * Mirrors the map left to right, toggling the hflip flag of every entry
+ */
+void map_hflip(u16 * map, std::size_t width, std::size_t height);
+
+/**
+ * Mirrors the map top to bottom, toggling the vflip flag of every entry
+ */
+void map_vflip(u16 * map, std::size_t width, std::size_t height);
+
+/**
+ * Rotates the map 180 degrees, toggling both flip flags of every entry
+ */
+void map_rotate(u16 * map, std::size_t width, std::size_t height);
+
+/**
+ * Swaps the rows and columns of the map, which is then height entries wide
+ * Only the layout changes: the VDP cannot transpose the tiles themselves, so
+ * the flags are left alone
+ */
+void map_transpose(u16 * map, std::size_t width, std::size_t height);
+
+/**
+ * Copies an area of a map to the start of another (or the same) map, where it
+ * is rect.width entries wide
+ */
+void map_crop(u16 const * from, std::size_t width, MapRect const & rect,
+							u16 * to);
+
+/**
+ * Repeats the map across and down, leaving a map width * across entries wide
+ * The map must have room for the result, with the source at the start
+ */
+void map_tile(u16 * map, std::size_t width, std::size_t height,
+							std::size_t across, std::size_t down);
+
+/**
+ * Copies another map over this one with its top left corner at x, y
+ * Anything that falls outside the map is clipped
+ */
+void map_paste(u16 * map, std::size_t width, std::size_t height,
+							 u16 const * from, std::size_t from_width,
+							 std::size_t from_height, std::size_t x, std::size_t y);
+
+#endif
@@ -2,6 +2,7 @@
 #define MDMAPMOD__TMAPUTILS_H
 
 #include "common.hpp"
+#include <cstddef>
 
 #define PRIORITY_BIT 15
 #define PALETTE_BIT 13
@@ -10,35 +11,39 @@
 
 #define TILE_MASK 0x7ff
 
-u16 priority_flag(u16 entry, bool set = true)
+/**
+ * Any number of entry edits combined into one operation, so that they are all
+ * applied in a single pass over the map
+ */
+struct EntryEdit
 {
-	return set ? entry |= (1 << PRIORITY_BIT) : entry &= ~(1 << PRIORITY_BIT);
-}
-
-u16 vflip_flag(u16 entry, bool set = true)
-{
-	return set ? entry |= (1 << VFLIP_BIT) : entry &= ~(1 << VFLIP_BIT);
-}
-
-u16 hflip_flag(u16 entry, bool set = true)
-{
-	return set ? entry |= (1 << HFLIP_BIT) : entry &= ~(1 << HFLIP_BIT);
-}
-
-u16 set_pal_line(u16 entry, u8 pal_line)
-{
-	u16 out = entry;
-	out &= 0x9fff;
-	return out |= (pal_line << PALETTE_BIT);
-}
-
-u16 modify_chridx(u16 entry, s16 idx_delta)
-{
-	s16 chridx = entry & TILE_MASK;
-	chridx += idx_delta;
-	chridx &= TILE_MASK;
-	entry &= 0xf800;
-	return entry | chridx;
-}
+	// flag edits, applied as (entry & and_mask) | or_value
+	// (these never touch the tile index)
+	u16 and_mask;
+	u16 or_value;
+
+	// added to the tile index, wrapping around within it
+	u16 idx_delta;
+	// leave entries with tile index 0 pointing to tile 0
+	bool preserve_idx0;
+
+	// only entries with a tile index in this range (inclusive) are edited
+	u16 idx_min;
+	u16 idx_max;
+
+	/**
+	 * An edit which leaves every entry as it is
+	 */
+	EntryEdit();
+
+	void set_flag(u8 bit, bool set);
+
+	void set_pal_line(u8 pal_line);
+};
+
+/**
+ * Applies the edit to the entries (in native byte order) in place
+ */
+void apply_edit(EntryEdit const & edit, u16 * entries, size_t count);
 
 #endif
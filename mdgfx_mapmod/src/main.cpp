@@ -1,14 +1,21 @@
 #include <getopt.h>
 
-#include "/home/ryou/Projects/lib/endian.hpp"
 #include "/home/ryou/Projects/lib/filesys.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <optional>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "byteorder.hpp"
 #include "common.hpp"
+#include "enigma.hpp"
+#include "mappedfile.hpp"
+#include "maptransform.hpp"
 #include "project.hpp"
 #include "tmaputils.hpp"
 
@@ -17,6 +24,22 @@ using namespace std;
 void process_args(int argc, char ** argv);
 void print_help();
 
+// compression of a map file
+enum Codec
+{
+	CODEC_NONE,
+	CODEC_ENIGMA
+};
+
+// a map to paste over the output, with its top left corner at x, y
+struct MapPaste
+{
+	size_t x;
+	size_t y;
+	size_t width;
+	string path;
+};
+
 struct RuntimeConfig
 {
 	optional<u8> pal_line;
@@ -24,21 +47,36 @@ struct RuntimeConfig
 	optional<bool> vflip;
 	optional<bool> priority;
 	optional<s16> chridx_delta;
+	// only edit entries with a tile index in this range
+	optional<pair<u16, u16>> idx_range;
 
-	u8 width;
+	size_t width;
 
 	bool in_place;
 	bool map_hflip;
 	bool map_vflip;
+	bool map_rotate;
+	bool map_transpose;
 	bool preserve_idx0;
 
+	// area to cut out of the map
+	optional<MapRect> crop;
+	// number of times to repeat the map across and down
+	optional<pair<size_t, size_t>> tile;
+	// another map to copy over the result
+	optional<MapPaste> paste;
+
 	string in_tmap;
 	string out_tmap;
 
+	Codec in_codec;
+	Codec out_codec;
+
 	RuntimeConfig() :
 			pal_line(nullopt), hflip(nullopt), vflip(nullopt), priority(nullopt),
 			chridx_delta(nullopt), width(0), in_place(false), map_hflip(false),
-			map_vflip(false), preserve_idx0(false)
+			map_vflip(false), map_rotate(false), map_transpose(false),
+			preserve_idx0(false), in_codec(CODEC_NONE), out_codec(CODEC_NONE)
 	{
 	}
 } cfg;
@@ -61,7 +99,7 @@ int main(int argc, char ** argv)
 			cerr << "No output specified" << endl;
 			exit(8);
 		}
-		else
+		else if(cfg.in_place)
 		{
 			cfg.out_tmap = cfg.in_tmap;
 		}
@@ -69,86 +107,184 @@ int main(int argc, char ** argv)
 		if(cfg.pal_line.has_value() && cfg.pal_line.value() > 3)
 			throw out_of_range("Palette line must be a value between 0 and 3");
 
-		if((cfg.map_hflip || cfg.map_vflip) && cfg.width < 1)
-			throw out_of_range(
-					"Width must be set when using --map-hflip / --map-vflip");
-
-		auto in_size = stat(cfg.in_tmap).st_size;
-		if(in_size % 2 == 1)
-			throw runtime_error(
-					"Specified input file appears to be invalid (odd number of bytes)");
+		bool const transform { cfg.map_hflip || cfg.map_vflip || cfg.map_rotate ||
+													 cfg.map_transpose || cfg.crop.has_value() ||
+													 cfg.tile.has_value() || cfg.paste.has_value() };
+		if(transform && cfg.width < 1)
+			throw out_of_range("Width must be set when using map transforms");
+
+		// a compressed map can't be edited where it is, so it's unpacked to
+		// memory (in MD byte order, same as a map file)
+		vector<u16> in_map;
+		size_t in_count;
+		if(cfg.in_codec == CODEC_ENIGMA)
+		{
+			MappedFile const in { cfg.in_tmap, false };
+			in_map = enigma_decode(in.data(), in.size());
+			md_byte_order(in_map.data(), in_map.size());
+			in_count = in_map.size();
+		}
+		else
+		{
+			auto in_size = stat(cfg.in_tmap).st_size;
+			if(in_size % 2 == 1)
+				throw runtime_error(
+						"Specified input file appears to be invalid (odd number of bytes)");
+			in_count = (size_t)in_size / 2;
+		}
 
-		if(cfg.width > 0 && (in_size % cfg.width > 0))
+		if(cfg.width > 0 && (in_count % cfg.width > 0))
 			throw out_of_range(
 					"Tile count in source file not correct for specified width");
 
-		auto in { ifstream_checked(cfg.in_tmap) };
-		vector<u16> map;
-		map.reserve(in_size / 2);
+		// without a width, the whole map is treated as a single row
+		size_t width { cfg.width > 0 ? cfg.width : in_count },
+				height { width > 0 ? in_count / width : 0 };
+
+		MapRect crop { 0, 0, width, height };
+		if(cfg.crop.has_value())
+		{
+			crop = cfg.crop.value();
+			if(crop.width == 0 || crop.height == 0 || crop.x + crop.width > width ||
+				 crop.y + crop.height > height)
+				throw out_of_range("Crop area is outside the map");
+		}
+		pair<size_t, size_t> const tile { cfg.tile.value_or(make_pair(1, 1)) };
+
+		// size of the map after the crop and tiling
+		size_t const out_count { crop.width * crop.height * tile.first *
+														 tile.second };
+
+		// the map is edited directly in the mapped output file: when editing in
+		// place, that's the source itself; otherwise the (cropped) source is
+		// copied over first
+		// if either side is compressed, the map is edited in memory instead and
+		// written out at the end
+		bool const packed { cfg.in_codec != CODEC_NONE ||
+												cfg.out_codec != CODEC_NONE };
+		// (the output may name the source by another path or through a link, and
+		// truncating it then would wipe out the source before it's read)
+		error_code same_error;
+		bool const same_file { cfg.out_tmap == cfg.in_tmap ||
+														 filesystem::equivalent(cfg.in_tmap, cfg.out_tmap,
+																										same_error) };
+
+		// the pasted map is opened and checked before the output is touched, so a
+		// bad paste can't leave an in place target half edited
+		unique_ptr<MappedFile const> paste_from;
+		if(cfg.paste.has_value())
+		{
+			auto const & paste { cfg.paste.value() };
+			paste_from.reset(new MappedFile(paste.path, false));
+			if(paste_from->size() % (paste.width * sizeof(u16)) > 0)
+				throw out_of_range(
+						"Tile count in pasted map not correct for specified width");
+		}
 
-		u8 buff[2];
-		u16 entry;
-		auto endian_copy = endian_copy_func(true);
-		while(in.good())
+		unique_ptr<MappedFile> out;
+		vector<u16> out_map;
+		if(packed)
 		{
-			in.read((char *)buff, 2);
-			if(in.good())
+			out_map.resize(out_count);
+			if(cfg.in_codec != CODEC_NONE)
+				map_crop(in_map.data(), width, crop, out_map.data());
+			else
 			{
-				endian_copy(buff, buff + 2, (u8 *)&entry);
-				map.push_back(entry);
+				MappedFile const in { cfg.in_tmap, false };
+				map_crop((u16 const *)in.data(), width, crop, out_map.data());
 			}
 		}
-		in.close();
-
-		auto out { ofstream_checked(cfg.out_tmap) };
-
-		for(auto & entry : map)
+		else if(same_file)
+		{
+			out.reset(new MappedFile(cfg.out_tmap, true));
+			if(out_count > in_count)
+				out->resize(out_count * sizeof(u16));
+			if(cfg.crop.has_value())
+				map_crop((u16 *)out->data(), width, crop, (u16 *)out->data());
+		}
+		else
+		{
+			MappedFile const in { cfg.in_tmap, false };
+			out.reset(new MappedFile(cfg.out_tmap, out_count * sizeof(u16)));
+			map_crop((u16 const *)in.data(), width, crop, (u16 *)out->data());
+		}
+		width = crop.width;
+		height = crop.height;
+
+		u16 * map { packed ? out_map.data() : (u16 *)out->data() };
+		md_byte_order(map, width * height);
+
+		// all the entry edits are combined and done in one pass
+		EntryEdit edit;
+		if(cfg.hflip.has_value())
+			edit.set_flag(HFLIP_BIT, cfg.hflip.value());
+		if(cfg.vflip.has_value())
+			edit.set_flag(VFLIP_BIT, cfg.vflip.value());
+		if(cfg.priority.has_value())
+			edit.set_flag(PRIORITY_BIT, cfg.priority.value());
+		if(cfg.pal_line.has_value())
+			edit.set_pal_line(cfg.pal_line.value());
+		if(cfg.chridx_delta.has_value())
+			edit.idx_delta = (u16)cfg.chridx_delta.value();
+		edit.preserve_idx0 = cfg.preserve_idx0;
+		if(cfg.idx_range.has_value())
 		{
-			if(cfg.hflip.has_value())
-				entry = hflip_flag(entry, cfg.hflip.value());
+			edit.idx_min = cfg.idx_range.value().first;
+			edit.idx_max = cfg.idx_range.value().second;
+		}
+		apply_edit(edit, map, width * height);
 
-			if(cfg.vflip.has_value())
-				entry = vflip_flag(entry, cfg.vflip.value());
+		if(cfg.map_hflip)
+			map_hflip(map, width, height);
 
-			if(cfg.priority.has_value())
-				entry = priority_flag(entry, cfg.priority.value());
+		if(cfg.map_vflip)
+			map_vflip(map, width, height);
 
-			if(cfg.pal_line.has_value())
-				entry = set_pal_line(entry, cfg.pal_line.value());
+		if(cfg.map_rotate)
+			map_rotate(map, width, height);
 
-			if(cfg.chridx_delta.has_value() &&
-				 (cfg.preserve_idx0 && (entry & TILE_MASK) != 0))
-				entry = modify_chridx(entry, cfg.chridx_delta.value());
+		if(cfg.map_transpose)
+		{
+			map_transpose(map, width, height);
+			swap(width, height);
 		}
 
-		if(cfg.map_hflip)
-		{
-			size_t rows = map.size() / cfg.width;
-			vector<u16> row_buff;
-			row_buff.reserve(cfg.width);
-			for(size_t i = 0; i < rows; ++i)
-			{
-				auto map_iter = map.begin() + (i * cfg.width);
-				reverse_copy(map_iter, map_iter + cfg.width, row_buff.begin());
-				copy(row_buff.begin(), row_buff.begin() + cfg.width, map_iter);
-			}
+		// back to MD byte order; tiling and pasting only move entries around, so
+		// they're done after
+		md_byte_order(map, width * height);
 
-			// toggle hflip flag
-			for(auto & entry : map)
-				entry ^= (1U << HFLIP_BIT);
-		}
-		else if(cfg.map_vflip)
+		if(cfg.tile.has_value())
 		{
+			map_tile(map, width, height, tile.first, tile.second);
+			width *= tile.first;
+			height *= tile.second;
 		}
 
-		for(auto & entry : map)
+		if(cfg.paste.has_value())
 		{
-			endian_copy((u8 *)&entry, ((u8 *)&entry) + 2, buff);
-			out.write((char *)buff, 2);
+			auto const & paste { cfg.paste.value() };
+			map_paste(map, width, height, (u16 const *)paste_from->data(), paste.width,
+								paste_from->size() / sizeof(u16) / paste.width, paste.x,
+								paste.y);
 		}
 
-		out.flush();
-		out.close();
+		if(packed)
+		{
+			// (the source is no longer mapped, so this is safe in place)
+			vector<u8> out_data;
+			if(cfg.out_codec == CODEC_ENIGMA)
+			{
+				md_byte_order(map, out_count);
+				out_data = enigma_encode(out_map);
+			}
+			else
+				out_data.assign((u8 const *)map, (u8 const *)(map + out_count));
+			MappedFile const out_file { cfg.out_tmap, out_data.size() };
+			memcpy(out_file.data(), out_data.data(), out_data.size());
+		}
+		// an in place crop leaves the rest of the file to be cut off
+		else if(out_count < out->size() / sizeof(u16))
+			out->resize(out_count * sizeof(u16));
 	}
 	catch(exception const & e)
 	{
@@ -158,6 +294,33 @@ int main(int argc, char ** argv)
 	return 0;
 }
 
+// comma separated list of exactly count numbers
+vector<size_t> parse_sizes(string const & arg, size_t count)
+{
+	vector<size_t> values;
+	stringstream ss { arg };
+	string value;
+	while(getline(ss, value, ','))
+	{
+		size_t parsed_size;
+		values.push_back(stoul(value, &parsed_size));
+		if(parsed_size != value.size())
+			throw invalid_argument(value);
+	}
+	if(values.size() != count)
+		throw invalid_argument(arg);
+	return values;
+}
+
+Codec parse_codec(string const & arg)
+{
+	if(arg == "enigma")
+		return CODEC_ENIGMA;
+	if(arg != "none")
+		throw invalid_argument(arg);
+	return CODEC_NONE;
+}
+
 void process_args(int argc, char ** argv)
 {
 	std::vector<option> long_opts {
@@ -173,10 +336,18 @@ void process_args(int argc, char ** argv)
 		{ "width", required_argument, nullptr, 'w' },
 		{ "map-hflip", no_argument, nullptr, 'm' },
 		{ "map-vflip", no_argument, nullptr, 'f' },
+		{ "map-rotate", no_argument, nullptr, 'R' },
+		{ "map-transpose", no_argument, nullptr, 't' },
+		{ "crop", required_argument, nullptr, 'x' },
+		{ "tile", required_argument, nullptr, 'n' },
+		{ "paste", required_argument, nullptr, 'a' },
 		{ "preserve-index-zero", no_argument, nullptr, 'z' },
+		{ "index-range", required_argument, nullptr, 'r' },
+		{ "in-compress", required_argument, nullptr, 'I' },
+		{ "out-compress", required_argument, nullptr, 'O' },
 		{ "output", required_argument, nullptr, 'o' }
 	};
-	std::string short_opts { "+:hHvVpPl:c:i" };
+	std::string short_opts { "+:hHvVpPl:c:iw:mfRtx:n:a:zr:I:O:o:" };
 
 	while(true)
 	{
@@ -247,10 +418,32 @@ void process_args(int argc, char ** argv)
 				cfg.preserve_idx0 = true;
 				break;
 
+			// first-last tile index (inclusive)
+			case 'r':
+				try
+				{
+					string const range { optarg };
+					size_t const split { range.find('-') };
+					if(split == string::npos)
+						throw invalid_argument("");
+					int const first { stoi(range.substr(0, split)) },
+							last { stoi(range.substr(split + 1)) };
+					if(first < 0 || last > TILE_MASK || first > last)
+						throw out_of_range("");
+					cfg.idx_range = make_pair((u16)first, (u16)last);
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for tile index range: " << optarg
+							 << endl;
+					exit(14);
+				}
+				break;
+
 			case 'w':
 				try
 				{
-					cfg.width = (u16)stoi(optarg);
+					cfg.width = (size_t)stoul(optarg);
 				}
 				catch(const exception & ex)
 				{
@@ -267,6 +460,96 @@ void process_args(int argc, char ** argv)
 				cfg.map_vflip = true;
 				break;
 
+			case 'R':
+				cfg.map_rotate = true;
+				break;
+
+			case 't':
+				cfg.map_transpose = true;
+				break;
+
+			// x,y,width,height
+			case 'x':
+				try
+				{
+					auto const values { parse_sizes(optarg, 4) };
+					cfg.crop = MapRect { values[0], values[1], values[2], values[3] };
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for crop area: " << optarg << endl;
+					exit(15);
+				}
+				break;
+
+			// across,down
+			case 'n':
+				try
+				{
+					auto const values { parse_sizes(optarg, 2) };
+					if(values[0] < 1 || values[1] < 1)
+						throw out_of_range("");
+					cfg.tile = make_pair(values[0], values[1]);
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for tile count: " << optarg << endl;
+					exit(16);
+				}
+				break;
+
+			// x,y,width,file
+			case 'a':
+				try
+				{
+					string const arg { optarg };
+					size_t split { 0 };
+					for(int this_comma { 0 }; this_comma < 3; ++this_comma)
+					{
+						split = arg.find(',', split);
+						if(split == string::npos)
+							throw invalid_argument("");
+						++split;
+					}
+					auto const values { parse_sizes(arg.substr(0, split - 1), 3) };
+					if(values[2] < 1 || split == arg.size())
+						throw out_of_range("");
+					cfg.paste =
+							MapPaste { values[0], values[1], values[2], arg.substr(split) };
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for paste: " << optarg << endl;
+					exit(17);
+				}
+				break;
+
+			case 'I':
+				try
+				{
+					cfg.in_codec = parse_codec(optarg);
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for input compression: " << optarg
+							 << endl;
+					exit(18);
+				}
+				break;
+
+			case 'O':
+				try
+				{
+					cfg.out_codec = parse_codec(optarg);
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for output compression: " << optarg
+							 << endl;
+					exit(19);
+				}
+				break;
+
 			case ':':
 				cerr << "Missing argument for option " << to_string(optopt) << endl;
 				exit(1);
@@ -275,10 +558,11 @@ void process_args(int argc, char ** argv)
 				cerr << "Unknown option" << endl;
 				exit(2);
 		}
+	}
 
-		// remaining option should be input
+	// remaining option should be input
+	if(optind < argc)
 		cfg.in_tmap = argv[optind];
-	}
 }
 
 void print_help()
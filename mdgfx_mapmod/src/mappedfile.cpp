@@ -0,0 +1,108 @@
+#include "mappedfile.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+int open_checked(string const & path, int flags)
+{
+	int fd { open(path.c_str(), flags, 0666) };
+	if(fd < 0)
+		throw runtime_error(path + ": " + strerror(errno));
+	return fd;
+}
+} // namespace
+
+MappedFile::MappedFile(string const & path, bool writable) :
+		m_path(path), m_data(nullptr), m_size(0)
+{
+	int fd { open_checked(path, writable ? O_RDWR : O_RDONLY) };
+
+	struct stat fileinfo;
+	if(fstat(fd, &fileinfo) != 0)
+	{
+		close(fd);
+		throw runtime_error(path + ": " + strerror(errno));
+	}
+	m_size = fileinfo.st_size;
+
+	map(fd, writable);
+}
+
+MappedFile::MappedFile(string const & path, size_t size) :
+		m_path(path), m_data(nullptr), m_size(size)
+{
+	int fd { open_checked(path, O_RDWR | O_CREAT | O_TRUNC) };
+	if(ftruncate(fd, size) != 0)
+	{
+		close(fd);
+		throw runtime_error(path + ": " + strerror(errno));
+	}
+
+	map(fd, true);
+}
+
+void MappedFile::map(int fd, bool writable)
+{
+	// an empty file can't be mapped, but there's nothing to edit anyway
+	if(m_size > 0)
+	{
+		void * mapped { mmap(nullptr, m_size,
+												 writable ? PROT_READ | PROT_WRITE : PROT_READ,
+												 MAP_SHARED, fd, 0) };
+		if(mapped == MAP_FAILED)
+		{
+			int const err { errno };
+			close(fd);
+			throw runtime_error(strerror(err));
+		}
+		m_data = (u8 *)mapped;
+	}
+
+	// the mapping stays valid after the file is closed
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	unmap();
+}
+
+void MappedFile::unmap()
+{
+	if(m_data != nullptr)
+		munmap(m_data, m_size);
+	m_data = nullptr;
+}
+
+void MappedFile::resize(size_t size)
+{
+	unmap();
+
+	int fd { open_checked(m_path, O_RDWR) };
+	if(ftruncate(fd, size) != 0)
+	{
+		close(fd);
+		throw runtime_error(m_path + ": " + strerror(errno));
+	}
+	m_size = size;
+
+	map(fd, true);
+}
+
+u8 * MappedFile::data() const
+{
+	return m_data;
+}
+
+size_t MappedFile::size() const
+{
+	return m_size;
+}
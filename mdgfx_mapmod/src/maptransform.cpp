@@ -0,0 +1,133 @@
+#include "maptransform.hpp"
+#include "tmaputils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+void toggle_flags(u16 * map, size_t count, u16 flags)
+{
+	for(u16 * map_end { map + count }; map != map_end; ++map)
+		*map ^= flags;
+}
+
+// size of the square blocks swapped by the transpose, small enough for two to
+// stay in L1 cache
+constexpr size_t TRANSPOSE_BLOCK { 32 };
+
+void transpose_square(u16 * map, size_t size)
+{
+	// swap each block above the diagonal with its mirror below, so both sides
+	// are walked a cache line at a time
+	for(size_t block_row { 0 }; block_row < size; block_row += TRANSPOSE_BLOCK)
+	{
+		size_t const row_end { min(block_row + TRANSPOSE_BLOCK, size) };
+		for(size_t block_col { block_row }; block_col < size;
+				block_col += TRANSPOSE_BLOCK)
+		{
+			size_t const col_end { min(block_col + TRANSPOSE_BLOCK, size) };
+			for(size_t row { block_row }; row < row_end; ++row)
+				for(size_t col { block_col == block_row ? row + 1 : block_col };
+						col < col_end; ++col)
+					swap(map[row * size + col], map[col * size + row]);
+		}
+	}
+}
+
+void transpose_rect(u16 * map, size_t width, size_t height)
+{
+	// entry i moves to (i * height) mod (count - 1); follow each cycle of moves
+	// once, marking the entries as they're placed
+	// (the first and last entries never move)
+	size_t const count { width * height };
+	vector<bool> placed(count, false);
+	for(size_t start { 1 }; start + 1 < count; ++start)
+	{
+		if(placed[start])
+			continue;
+		size_t this_entry { start };
+		u16 carry { map[start] };
+		do
+		{
+			size_t const next { (this_entry * height) % (count - 1) };
+			swap(carry, map[next]);
+			placed[this_entry] = true;
+			this_entry = next;
+		} while(this_entry != start);
+	}
+}
+} // namespace
+
+void map_hflip(u16 * map, size_t width, size_t height)
+{
+	for(size_t row { 0 }; row < height; ++row)
+		reverse(map + row * width, map + (row + 1) * width);
+	toggle_flags(map, width * height, 1 << HFLIP_BIT);
+}
+
+void map_vflip(u16 * map, size_t width, size_t height)
+{
+	for(size_t row { 0 }; row < height / 2; ++row)
+		swap_ranges(map + row * width, map + (row + 1) * width,
+								map + (height - 1 - row) * width);
+	toggle_flags(map, width * height, 1 << VFLIP_BIT);
+}
+
+void map_rotate(u16 * map, size_t width, size_t height)
+{
+	// mirroring both ways is the same as reversing the whole map
+	reverse(map, map + width * height);
+	toggle_flags(map, width * height, (1 << HFLIP_BIT) | (1 << VFLIP_BIT));
+}
+
+void map_transpose(u16 * map, size_t width, size_t height)
+{
+	if(width == height)
+		transpose_square(map, width);
+	else if(width > 1 && height > 1)
+		transpose_rect(map, width, height);
+}
+
+void map_crop(u16 const * from, size_t width, MapRect const & rect, u16 * to)
+{
+	// rows only ever move towards the start, so this also works in place
+	for(size_t row { 0 }; row < rect.height; ++row)
+		memmove(to + row * rect.width, from + (rect.y + row) * width + rect.x,
+						rect.width * sizeof(u16));
+}
+
+void map_tile(u16 * map, size_t width, size_t height, size_t across,
+							size_t down)
+{
+	size_t const tiled_width { width * across };
+
+	// spread the rows out from the bottom up, so no row is overwritten before
+	// it's been copied
+	for(size_t row { height }; row-- > 0;)
+	{
+		u16 * const tiled_row { map + row * tiled_width };
+		for(size_t this_copy { across }; this_copy-- > 0;)
+			memmove(tiled_row + this_copy * width, map + row * width,
+							width * sizeof(u16));
+	}
+
+	// then repeat that band the rest of the way down
+	size_t const band_size { tiled_width * height };
+	for(size_t this_copy { 1 }; this_copy < down; ++this_copy)
+		copy(map, map + band_size, map + this_copy * band_size);
+}
+
+void map_paste(u16 * map, size_t width, size_t height, u16 const * from,
+							 size_t from_width, size_t from_height, size_t x, size_t y)
+{
+	if(x >= width || y >= height)
+		return;
+	size_t const copy_width { min(from_width, width - x) },
+			copy_height { min(from_height, height - y) };
+	for(size_t row { 0 }; row < copy_height; ++row)
+		copy(from + row * from_width, from + row * from_width + copy_width,
+				 map + (y + row) * width + x);
+}
@@ -0,0 +1,87 @@
+#include "tmaputils.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+EntryEdit::EntryEdit() :
+		and_mask(0xffff), or_value(0), idx_delta(0), preserve_idx0(false),
+		idx_min(0), idx_max(TILE_MASK)
+{
+}
+
+void EntryEdit::set_flag(u8 bit, bool set)
+{
+	and_mask &= ~(1 << bit);
+	if(set)
+		or_value |= (1 << bit);
+	else
+		or_value &= ~(1 << bit);
+}
+
+void EntryEdit::set_pal_line(u8 pal_line)
+{
+	and_mask &= 0x9fff;
+	or_value = (or_value & 0x9fff) | ((pal_line & 3) << PALETTE_BIT);
+}
+
+namespace
+{
+u16 apply_edit(EntryEdit const & edit, u16 entry)
+{
+	u16 const chridx = entry & TILE_MASK;
+	if(chridx < edit.idx_min || chridx > edit.idx_max)
+		return entry;
+
+	u16 out = (entry & edit.and_mask & ~TILE_MASK) | edit.or_value;
+	if(edit.preserve_idx0 && chridx == 0)
+		return out;
+	return out | ((chridx + edit.idx_delta) & TILE_MASK);
+}
+} // namespace
+
+void apply_edit(EntryEdit const & edit, u16 * entries, size_t count)
+{
+	size_t this_entry { 0 };
+
+#ifdef __SSE2__
+	// eight entries at a time, with the range and index 0 checks done as masks
+	// rather than branches
+	// (tile indices are at most 11 bits, so the signed compares are safe)
+	__m128i const tile_mask { _mm_set1_epi16(TILE_MASK) },
+			flag_and { _mm_set1_epi16((short)(edit.and_mask & ~TILE_MASK)) },
+			flag_or { _mm_set1_epi16((short)edit.or_value) },
+			idx_delta { _mm_set1_epi16((short)edit.idx_delta) },
+			idx_below { _mm_set1_epi16((short)edit.idx_min) },
+			idx_above { _mm_set1_epi16((short)edit.idx_max) },
+			zero { _mm_setzero_si128() };
+
+	size_t const vec_count { count & ~(size_t)7 };
+	for(; this_entry < vec_count; this_entry += 8)
+	{
+		__m128i * io { (__m128i *)(entries + this_entry) };
+		__m128i const in { _mm_loadu_si128(io) };
+		__m128i const chridx { _mm_and_si128(in, tile_mask) };
+
+		__m128i const skip { _mm_or_si128(_mm_cmpgt_epi16(idx_below, chridx),
+																			_mm_cmpgt_epi16(chridx, idx_above)) };
+
+		__m128i new_idx { _mm_and_si128(_mm_add_epi16(chridx, idx_delta),
+																		tile_mask) };
+		if(edit.preserve_idx0)
+		{
+			__m128i const keep_idx { _mm_cmpeq_epi16(chridx, zero) };
+			new_idx = _mm_or_si128(_mm_and_si128(keep_idx, chridx),
+														 _mm_andnot_si128(keep_idx, new_idx));
+		}
+
+		__m128i const out { _mm_or_si128(
+				_mm_or_si128(_mm_and_si128(in, flag_and), flag_or), new_idx) };
+		_mm_storeu_si128(io, _mm_or_si128(_mm_and_si128(skip, in),
+																			_mm_andnot_si128(skip, out)));
+	}
+#endif
+
+	for(; this_entry < count; ++this_entry)
+		entries[this_entry] = apply_edit(edit, entries[this_entry]);
+}
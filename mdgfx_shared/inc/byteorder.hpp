@@ -0,0 +1,27 @@
+#ifndef MDGFX__BYTEORDER_H
+#define MDGFX__BYTEORDER_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * One version (scalar, SSE2 or AVX2) of the swap of the bytes within each word
+ */
+struct WordSwap
+{
+	char const * name;
+	void (*swap_words)(u16 *, std::size_t);
+};
+
+/**
+ * All the versions this machine can run, scalar first and fastest last
+ */
+std::vector<WordSwap> available_word_swaps();
+
+/**
+ * Converts words between native and MD (big endian) byte order, in place
+ */
+void md_byte_order(u16 * words, std::size_t count);
+
+#endif
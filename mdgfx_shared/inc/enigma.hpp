@@ -0,0 +1,23 @@
+#ifndef MDGFX__ENIGMA_H
+#define MDGFX__ENIGMA_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * Compresses a tilemap (as native order nametable entries) in the Enigma
+ * format, as used by the decompressor in most Sega published games
+ */
+std::vector<u8> enigma_encode(std::vector<u16> const & map);
+
+/**
+ * Decompresses Enigma data back to native order nametable entries
+ * If cycles is given, it is set to an estimate of the 68000 cycles the
+ * standard decompressor would take
+ * Throws if the data is malformed or runs out early
+ */
+std::vector<u16> enigma_decode(u8 const * data, std::size_t size,
+															 std::size_t * cycles = nullptr);
+
+#endif
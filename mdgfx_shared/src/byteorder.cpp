@@ -0,0 +1,75 @@
+#include "byteorder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MDGFX_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+void swap_words_scalar(u16 * words, size_t count)
+{
+	for(u16 * words_end { words + count }; words != words_end; ++words)
+		*words = (u16)((*words << 8) | (*words >> 8));
+}
+
+#ifdef MDGFX_X86
+
+__attribute__((target("sse2"))) void swap_words_sse2(u16 * words, size_t count)
+{
+	// eight words per register, with the tail done one at a time
+	size_t const vec_count { count & ~(size_t)7 };
+	for(size_t this_word { 0 }; this_word < vec_count; this_word += 8)
+	{
+		__m128i * io { (__m128i *)(words + this_word) };
+		__m128i in { _mm_loadu_si128(io) };
+		_mm_storeu_si128(io,
+										 _mm_or_si128(_mm_slli_epi16(in, 8), _mm_srli_epi16(in, 8)));
+	}
+	swap_words_scalar(words + vec_count, count - vec_count);
+}
+
+__attribute__((target("avx2"))) void swap_words_avx2(u16 * words, size_t count)
+{
+	size_t const vec_count { count & ~(size_t)15 };
+	for(size_t this_word { 0 }; this_word < vec_count; this_word += 16)
+	{
+		__m256i * io { (__m256i *)(words + this_word) };
+		__m256i in { _mm256_loadu_si256(io) };
+		_mm256_storeu_si256(io, _mm256_or_si256(_mm256_slli_epi16(in, 8),
+																						_mm256_srli_epi16(in, 8)));
+	}
+	swap_words_scalar(words + vec_count, count - vec_count);
+}
+
+#endif
+
+// the fastest version this machine can run, chosen once at startup
+WordSwap const word_swap { available_word_swaps().back() };
+} // namespace
+
+vector<WordSwap> available_word_swaps()
+{
+	vector<WordSwap> swaps { { "scalar", swap_words_scalar } };
+#ifdef MDGFX_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		swaps.push_back({ "sse2", swap_words_sse2 });
+	if(__builtin_cpu_supports("avx2"))
+		swaps.push_back({ "avx2", swap_words_avx2 });
+#endif
+	return swaps;
+}
+
+void md_byte_order(u16 * words, size_t count)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	// already in the same order as the MD
+	(void)words;
+	(void)count;
+#else
+	word_swap.swap_words(words, count);
+#endif
+}
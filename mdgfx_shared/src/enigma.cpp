@@ -0,0 +1,358 @@
+#include "enigma.hpp"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+// Enigma format:
+// a six byte header: the number of bits in an inline tile index, a mask of
+// which flag bits (priority, palette high, palette low, vflip, hflip) are
+// present in inline values, then the starting incrementing value and the
+// common value as big endian words
+// then a bitstream, high bit first, of these:
+//  00 cccc - the incrementing value c+1 times, adding one to it each time
+//  01 cccc - the common value c+1 times
+//  100 cccc v - inline value v c+1 times
+//  101 cccc v - inline value v c+1 times, adding one to it each time
+//  110 cccc v - inline value v c+1 times, subtracting one from it each time
+//  111 cccc v... - c+1 inline values, one after another
+//  111 1111 - end of data
+// an inline value is a bit for each flag in the mask, then the tile index
+// the data is padded out to a whole word at the end
+
+constexpr size_t COUNT_BITS { 4 };
+constexpr size_t MAX_RUN { 16 };
+// (a count of 15 in the literal mode ends the data)
+constexpr size_t MAX_LITERALS { 15 };
+constexpr u8 END_COUNT { 0xf };
+
+constexpr u8 MODE_INCREMENTING { 0b00 };
+constexpr u8 MODE_COMMON { 0b01 };
+constexpr u8 MODE_REPEAT { 0b100 };
+constexpr u8 MODE_UP { 0b101 };
+constexpr u8 MODE_DOWN { 0b110 };
+constexpr u8 MODE_LITERAL { 0b111 };
+
+constexpr size_t FLAG_SHIFT { 11 };
+constexpr size_t FLAG_COUNT { 5 };
+constexpr u16 INDEX_MASK { 0x7ff };
+
+constexpr size_t HEADER_SIZE { 6 };
+// number of possible incrementing values tried when encoding
+constexpr size_t INCREMENTING_TRIES { 8 };
+
+// 68000 cycles for each part of the standard decompressor (EniDec), from the
+// timings of the instructions involved
+constexpr size_t CYCLES_BIT { 22 };
+constexpr size_t CYCLES_MODE { 56 };
+constexpr size_t CYCLES_INLINE { 64 };
+constexpr size_t CYCLES_ENTRY { 18 };
+
+class BitWriter
+{
+public:
+	BitWriter(vector<u8> & out) : m_out(out), m_bits(0), m_bitcount(0) {}
+
+	void put(u32 value, size_t length)
+	{
+		m_bits = (m_bits << length) | (value & ((1 << length) - 1));
+		m_bitcount += length;
+		while(m_bitcount >= 8)
+		{
+			m_bitcount -= 8;
+			m_out.push_back((u8)(m_bits >> m_bitcount));
+		}
+	}
+
+	// pads out the last byte with zeroes
+	void flush()
+	{
+		if(m_bitcount > 0)
+			put(0, 8 - m_bitcount);
+	}
+
+private:
+	vector<u8> & m_out;
+	u32 m_bits;
+	size_t m_bitcount;
+};
+
+class BitReader
+{
+public:
+	BitReader(u8 const * data, size_t size) :
+			m_data(data), m_size(size), m_bitpos(0)
+	{
+	}
+
+	// number of bits read so far
+	size_t used() const
+	{
+		return m_bitpos;
+	}
+
+	u32 get(size_t length)
+	{
+		u32 value { 0 };
+		for(size_t this_bit { 0 }; this_bit < length; ++this_bit)
+		{
+			if(m_bitpos >= m_size * 8)
+				throw runtime_error("Enigma data ends early");
+			value = (value << 1) |
+							((m_data[m_bitpos / 8] >> (7 - (m_bitpos % 8))) & 1);
+			++m_bitpos;
+		}
+		return value;
+	}
+
+private:
+	u8 const * m_data;
+	size_t m_size;
+	size_t m_bitpos;
+};
+
+struct EnigmaHeader
+{
+	u8 index_bits;
+	u8 flag_mask;
+	u16 incrementing;
+	u16 common;
+};
+
+void put_value(BitWriter & bits, EnigmaHeader const & header, u16 const value)
+{
+	for(size_t this_flag { FLAG_COUNT }; this_flag-- > 0;)
+	{
+		if(header.flag_mask & (1 << this_flag))
+			bits.put(value >> (FLAG_SHIFT + this_flag), 1);
+	}
+	bits.put(value & INDEX_MASK, header.index_bits);
+}
+
+u16 get_value(BitReader & bits, EnigmaHeader const & header)
+{
+	u16 value { 0 };
+	for(size_t this_flag { FLAG_COUNT }; this_flag-- > 0;)
+	{
+		if(header.flag_mask & (1 << this_flag))
+			value |= bits.get(1) << (FLAG_SHIFT + this_flag);
+	}
+	return value | bits.get(header.index_bits);
+}
+
+// length of the run at index where each entry is step more than the last
+size_t run_length(vector<u16> const & map, size_t const index, u16 const first,
+									u16 const step)
+{
+	size_t length { 0 };
+	u16 expected { first };
+	while(length < MAX_RUN && index + length < map.size() &&
+				map[index + length] == expected)
+	{
+		++length;
+		expected += step;
+	}
+	return length;
+}
+
+// longest run of an inline value (repeated, going up or going down) at index
+pair<u8, size_t> best_inline_run(vector<u16> const & map, size_t const index)
+{
+	u16 const value { map[index] };
+	pair<u8, size_t> best { MODE_REPEAT, run_length(map, index, value, 0) };
+	size_t const up { run_length(map, index, value, 1) };
+	if(up > best.second)
+		best = { MODE_UP, up };
+	size_t const down { run_length(map, index, value, (u16)-1) };
+	if(down > best.second)
+		best = { MODE_DOWN, down };
+	return best;
+}
+
+vector<u8> encode_with(vector<u16> const & map, EnigmaHeader const & header)
+{
+	vector<u8> out { header.index_bits,
+									 header.flag_mask,
+									 (u8)(header.incrementing >> 8),
+									 (u8)header.incrementing,
+									 (u8)(header.common >> 8),
+									 (u8)header.common };
+	BitWriter bits { out };
+
+	u16 incrementing { header.incrementing };
+	size_t index { 0 };
+	while(index < map.size())
+	{
+		// the header values cost nothing but the mode and count, so they win
+		// whenever they match
+		size_t const inc_run { run_length(map, index, incrementing, 1) };
+		size_t const common_run { run_length(map, index, header.common, 0) };
+		if(inc_run > 0 || common_run > 0)
+		{
+			if(inc_run >= common_run)
+			{
+				bits.put(MODE_INCREMENTING, 2);
+				bits.put(inc_run - 1, COUNT_BITS);
+				incrementing += inc_run;
+				index += inc_run;
+			}
+			else
+			{
+				bits.put(MODE_COMMON, 2);
+				bits.put(common_run - 1, COUNT_BITS);
+				index += common_run;
+			}
+			continue;
+		}
+
+		auto const run { best_inline_run(map, index) };
+		if(run.second > 1)
+		{
+			bits.put(run.first, 3);
+			bits.put(run.second - 1, COUNT_BITS);
+			put_value(bits, header, map[index]);
+			index += run.second;
+			continue;
+		}
+
+		// otherwise gather up single values until something that can be
+		// written more cheaply comes along
+		size_t literals { 1 };
+		while(literals < MAX_LITERALS && index + literals < map.size())
+		{
+			size_t const next { index + literals };
+			if(map[next] == incrementing || map[next] == header.common ||
+				 best_inline_run(map, next).second > 1)
+				break;
+			++literals;
+		}
+		bits.put(MODE_LITERAL, 3);
+		bits.put(literals - 1, COUNT_BITS);
+		for(size_t this_literal { 0 }; this_literal < literals; ++this_literal)
+			put_value(bits, header, map[index + this_literal]);
+		index += literals;
+	}
+
+	bits.put(MODE_LITERAL, 3);
+	bits.put(END_COUNT, COUNT_BITS);
+	bits.flush();
+	if(out.size() % 2 != 0)
+		out.push_back(0);
+
+	return out;
+}
+
+} // namespace
+
+vector<u8> enigma_encode(vector<u16> const & map)
+{
+	EnigmaHeader header { 1, 0, 0, 0 };
+
+	// inline values need enough bits for every tile index and flag in the map
+	u16 max_index { 0 };
+	for(auto const entry : map)
+	{
+		max_index = max<u16>(max_index, entry & INDEX_MASK);
+		header.flag_mask |= entry >> FLAG_SHIFT;
+	}
+	while((max_index >> header.index_bits) != 0)
+		++header.index_bits;
+
+	// the common value is simply the most frequent
+	std::map<u16, size_t> counts;
+	for(auto const entry : map)
+		++counts[entry];
+	size_t most { 0 };
+	for(auto const & count : counts)
+	{
+		if(count.second > most)
+		{
+			most = count.second;
+			header.common = count.first;
+		}
+	}
+
+	// the best incrementing value depends on how the map is laid out, but it's
+	// nearly always one of the first few values; try each of those
+	vector<u16> candidates;
+	for(size_t index { 0 };
+			index < map.size() && candidates.size() < INCREMENTING_TRIES; ++index)
+	{
+		if(find(candidates.begin(), candidates.end(), map[index]) ==
+			 candidates.end())
+			candidates.push_back(map[index]);
+	}
+	if(candidates.empty())
+		candidates.push_back(0);
+
+	vector<u8> best;
+	for(auto const candidate : candidates)
+	{
+		header.incrementing = candidate;
+		auto packed { encode_with(map, header) };
+		if(best.empty() || packed.size() < best.size())
+			best = move(packed);
+	}
+
+	return best;
+}
+
+vector<u16> enigma_decode(u8 const * data, size_t size, size_t * cycles)
+{
+	if(size < HEADER_SIZE)
+		throw runtime_error("Enigma data ends early");
+
+	EnigmaHeader const header { data[0], data[1],
+															(u16)((data[2] << 8) | data[3]),
+															(u16)((data[4] << 8) | data[5]) };
+	if(header.index_bits > FLAG_SHIFT || header.flag_mask >= (1 << FLAG_COUNT))
+		throw runtime_error("Invalid Enigma header");
+
+	BitReader bits { data + HEADER_SIZE, size - HEADER_SIZE };
+	vector<u16> map;
+	u16 incrementing { header.incrementing };
+	size_t spent { 0 };
+	while(true)
+	{
+		spent += CYCLES_MODE;
+		if(bits.get(1) == 0)
+		{
+			bool const common { bits.get(1) == 1 };
+			size_t const count { bits.get(COUNT_BITS) + 1 };
+			for(size_t this_entry { 0 }; this_entry < count; ++this_entry)
+				map.push_back(common ? header.common : incrementing++);
+			spent += CYCLES_ENTRY * count;
+			continue;
+		}
+
+		u8 const mode = 0b100 | bits.get(2);
+		size_t const count { bits.get(COUNT_BITS) + 1 };
+		if(mode == MODE_LITERAL)
+		{
+			if(count - 1 == END_COUNT)
+				break;
+			for(size_t this_entry { 0 }; this_entry < count; ++this_entry)
+				map.push_back(get_value(bits, header));
+			spent += (CYCLES_INLINE + CYCLES_ENTRY) * count;
+			continue;
+		}
+
+		u16 value { get_value(bits, header) };
+		spent += CYCLES_INLINE + CYCLES_ENTRY * count;
+		for(size_t this_entry { 0 }; this_entry < count; ++this_entry)
+		{
+			map.push_back(value);
+			if(mode == MODE_UP)
+				++value;
+			else if(mode == MODE_DOWN)
+				--value;
+		}
+	}
+
+	if(cycles != nullptr)
+		*cycles = spent + CYCLES_BIT * bits.used();
+	return map;
+}
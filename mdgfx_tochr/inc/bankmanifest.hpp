@@ -0,0 +1,79 @@
+#ifndef MDGFX__BANKMANIFEST_H
+#define MDGFX__BANKMANIFEST_H
+
+#include "common.hpp"
+#include "tileview.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * Content hashes of an image and each of its banks, kept alongside the outputs
+ * so that a rerun can skip the banks that haven't changed since the last one
+ * The hashes from the previous run are only used if the settings are the same
+ * The output files are listed too, so those a rerun no longer writes can be
+ * cleaned up
+ */
+class BankManifest
+{
+public:
+	/**
+	 * Loads the manifest from the previous run, if there is one
+	 */
+	BankManifest(std::string const & path, std::string const & settings);
+
+	/**
+	 * Hashes the tiles of the current image, as a whole and by bank
+	 */
+	void update(TileView const & tiles, std::size_t const bank_size);
+
+	bool image_unchanged() const;
+
+	bool bank_unchanged(std::size_t const bankidx) const;
+
+	/**
+	 * Output files (as suffixes to the output prefix) written by the previous
+	 * run, whatever its settings were
+	 */
+	std::vector<std::string> const & previous_outputs() const;
+
+	/**
+	 * Sets the output files listed for the current run
+	 */
+	void set_outputs(std::vector<std::string> const & suffixes);
+
+	/**
+	 * Contents of the manifest for the current image
+	 */
+	std::string str() const;
+
+private:
+	/**
+	 * Size, CRC32 and Adler32 of some tile data, the same as the output cache
+	 * key, so a collision in one checksum alone can't keep a stale bank
+	 */
+	struct ContentHash
+	{
+		u64 size;
+		u32 crc;
+		u32 adler;
+
+		ContentHash();
+
+		void add(u8 const * data, std::size_t length);
+
+		bool operator==(ContentHash const & other) const;
+	};
+
+	u32 m_settings_crc;
+
+	bool m_have_previous;
+	ContentHash m_previous_image;
+	std::vector<ContentHash> m_previous_banks;
+	std::vector<std::string> m_previous_outputs;
+
+	ContentHash m_image;
+	std::vector<ContentHash> m_banks;
+	std::vector<std::string> m_outputs;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MDGFX__CODEC_H
+#define MDGFX__CODEC_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// compression applied to an output file
+enum Codec
+{
+	CODEC_NONE,
+	CODEC_NEMESIS,
+	CODEC_ENIGMA,
+	CODEC_KOSINSKI,
+	CODEC_COMPER
+};
+
+/**
+ * Name of a codec, as given on the command line
+ */
+std::string codec_name(Codec const codec);
+
+// compressed output, with an estimate of the 68000 cycles needed to
+// decompress it
+struct Packed
+{
+	Codec codec;
+	std::string data;
+	std::size_t cycles;
+};
+
+/**
+ * Whether data of the given size is within the limits of a codec (Nemesis
+ * takes at most 0x7fff whole tiles, the word based codecs an even size)
+ */
+bool can_pack(Codec const codec, std::size_t const size);
+
+/**
+ * Compresses chr or tilemap data (as it would be written uncompressed) with
+ * the given codec, and checks that it decompresses back to the same
+ * Nemesis only takes chr data and Enigma only takes tilemaps
+ */
+Packed pack(Codec const codec, std::string const & data,
+						std::size_t const threads = 1);
+
+/**
+ * Compresses the data with each of the codecs (at the same time, if more than
+ * one thread is given) and keeps the one with the lowest size * byte_cost +
+ * cycles, earlier codecs winning ties
+ * Codecs which can't take data of this size are skipped
+ * Uncompressed data costs no cycles, as it can be DMAed straight from ROM
+ */
+Packed pack_best(std::vector<Codec> const & codecs, std::string const & data,
+								 std::size_t const byte_cost, std::size_t const threads = 1);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef MDGFX__COMPER_H
+#define MDGFX__COMPER_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * Compresses data (an even number of bytes) in the Comper format, which works
+ * on whole words and trades size for a much faster decompressor
+ */
+std::vector<u8> comper_encode(u8 const * data, std::size_t size);
+
+/**
+ * Decompresses Comper data
+ * If cycles is given, it is set to an estimate of the 68000 cycles the
+ * standard decompressor would take
+ * Throws if the data is malformed or runs out early
+ */
+std::vector<u8> comper_decode(u8 const * data, std::size_t size,
+															std::size_t * cycles = nullptr);
+
+#endif
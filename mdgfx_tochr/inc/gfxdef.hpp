@@ -41,4 +41,13 @@ size_t const BASIC_CHR_HEIGHT { MD_CHR.height() };
 // basic tiles are 1 byte per pixel
 constexpr size_t BASIC_CHR_BYTESZ { 64 };
 
+// packed tiles are 4 bits per pixel, one u32 per row with the leftmost pixel
+// in the high nibble (i.e. MD_CHR format, in big endian)
+struct PackedChr
+{
+	u32 rows[8];
+};
+
+constexpr size_t PACKED_CHR_BYTESZ { sizeof(PackedChr) };
+
 #endif
\ No newline at end of file
@@ -2,34 +2,39 @@
 #define MDGFX__GFXUTILS_H
 
 #include "gfxdef.hpp"
+#include "tileview.hpp"
 #include <chrgfx/chrgfx.hpp>
 #include <png++/png.hpp>
 
-bool is_blank_tile(byte_t const * chr);
+bool is_blank_tile(PackedChr const & chr);
 
-bool is_flat_tile(byte_t const * chr);
+bool is_flat_tile(PackedChr const & chr);
 
-bool is_identical_tile(byte_t const * chr1, byte_t const * chr2);
+bool is_identical_tile(PackedChr const & chr1, PackedChr const & chr2);
 
-void v_flip_tile(byte_t * chr);
+void v_flip_tile(PackedChr & chr);
 
-void h_flip_tile(byte_t * chr);
+void h_flip_tile(PackedChr & chr);
+
+void encode_md_chr(PackedChr const & chr, u8 * out);
+
+void encode_md_chrs(byte_t const * chrs, size_t count, u8 * out);
 
 void dump_md_palette(png::palette const & pal, std::ostream & out);
 
-void dump_md_tiles(buffer<byte_t> const & bank, std::ostream & out);
+void dump_md_tiles(TileView const & bank, std::ostream & out);
 
-void dump_md_tiles(buffer<byte_t> const & bank, std::ostream & out,
-									 size_t index, size_t length);
+void dump_md_tiles(TileView const & bank, std::ostream & out, size_t index,
+									 size_t length);
 
-void dump_md_tiles(std::vector<byte_t *> const & bank, std::ostream & out);
+void dump_md_tiles(std::vector<PackedChr> const & bank, std::ostream & out);
 
-void dump_md_tiles(std::vector<byte_t *> const & bank, std::ostream & out,
+void dump_md_tiles(std::vector<PackedChr> const & bank, std::ostream & out,
 									 size_t index, size_t length);
 
 void dump_md_tilemap(std::vector<u16> const & map, std::ostream & out);
 
-u16 make_nametable_entry(u16 tile_index, enum VDPPal const pal_line = PAL0,
+u16 make_nametable_entry(u32 tile_index, enum VDPPal const pal_line = PAL0,
 												 bool const priority = false, bool const h_flip = false,
 												 bool const v_flip = false);
 
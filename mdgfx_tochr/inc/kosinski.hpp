@@ -0,0 +1,24 @@
+#ifndef MDGFX__KOSINSKI_H
+#define MDGFX__KOSINSKI_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * Compresses data in the Kosinski format, as used by the Sonic games
+ * The encoding is chosen for the fewest bits overall, not just the longest
+ * copy at each point
+ */
+std::vector<u8> kosinski_encode(u8 const * data, std::size_t size);
+
+/**
+ * Decompresses Kosinski data
+ * If cycles is given, it is set to an estimate of the 68000 cycles the
+ * standard decompressor would take
+ * Throws if the data is malformed or runs out early
+ */
+std::vector<u8> kosinski_decode(u8 const * data, std::size_t size,
+																std::size_t * cycles = nullptr);
+
+#endif
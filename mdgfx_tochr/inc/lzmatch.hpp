@@ -0,0 +1,30 @@
+#ifndef MDGFX__LZMATCH_H
+#define MDGFX__LZMATCH_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * An earlier copy of the data at a position: every length up to this one (and
+ * longer than the match before it in the list) can be copied from this far back
+ */
+struct LzMatch
+{
+	std::size_t length;
+	std::size_t distance;
+};
+
+/**
+ * Finds the nearest earlier copy of each length at every position in the data,
+ * working in units of unit_size bytes (both lengths and distances are in units)
+ * Matches are at least two units long, no more than window units back and no
+ * longer than max_length, and may overlap the position they're copied to
+ */
+std::vector<std::vector<LzMatch>> find_lz_matches(u8 const * data,
+																									std::size_t size,
+																									std::size_t unit_size,
+																									std::size_t window,
+																									std::size_t max_length);
+
+#endif
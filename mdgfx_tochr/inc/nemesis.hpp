@@ -0,0 +1,32 @@
+#ifndef MDGFX__NEMESIS_H
+#define MDGFX__NEMESIS_H
+
+#include "common.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * Compresses MD tile data (a multiple of 32 bytes) in the Nemesis format, as
+ * used by the decompressor in most Sega published games
+ * Both the plain and XOR modes are tried (at the same time, if more than one
+ * thread is given) and the smaller is kept
+ */
+std::vector<u8> nemesis_encode(u8 const * data, std::size_t size,
+															 std::size_t const threads = 1);
+
+/**
+ * Whether data of the given size is whole tiles, and few enough of them, to
+ * be compressed in the Nemesis format
+ */
+bool nemesis_fits(std::size_t size);
+
+/**
+ * Decompresses Nemesis data back to MD tile data
+ * If cycles is given, it is set to an estimate of the 68000 cycles the
+ * standard decompressor would take
+ * Throws if the data is malformed or runs out early
+ */
+std::vector<u8> nemesis_decode(u8 const * data, std::size_t size,
+															 std::size_t * cycles = nullptr);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef MDGFX__OUTCACHE_H
+#define MDGFX__OUTCACHE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * On-disk cache of the files generated from a source image
+ * Entries are keyed on the contents of the source file along with a string
+ * describing the settings that affect the output, so a hit means the outputs
+ * would be identical and decoding/analysis can be skipped entirely
+ */
+class OutputCache
+{
+public:
+	OutputCache(std::string const & cache_dir, std::string const & source_path,
+							std::string const & settings);
+
+	/**
+	 * Recreates the cached output files with the given path prefix
+	 * Returns false if there is no entry for this source and settings
+	 */
+	bool restore(std::string const & out_prefix) const;
+
+	/**
+	 * Adds the output files (given as suffixes to the path prefix) to the cache
+	 */
+	void store(std::string const & out_prefix,
+						 std::vector<std::string> const & suffixes) const;
+
+private:
+	std::string m_cache_dir;
+	std::string m_entry_path;
+	std::string m_settings;
+};
+
+#endif
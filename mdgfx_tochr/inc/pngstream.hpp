@@ -0,0 +1,66 @@
+#ifndef MDGFX__PNGSTREAM_H
+#define MDGFX__PNGSTREAM_H
+
+#include "tileview.hpp"
+#include <cstdio>
+#include <png.h>
+#include <png++/png.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Decodes a paletted PNG one row of tiles (8 scanlines) at a time, so the
+ * full image never needs to be in memory
+ */
+class PngTileRowReader
+{
+public:
+	PngTileRowReader(std::string const & path);
+	~PngTileRowReader();
+
+	PngTileRowReader(PngTileRowReader const &) = delete;
+	PngTileRowReader & operator=(PngTileRowReader const &) = delete;
+
+	/**
+	 * Number of tiles in each row of tiles
+	 */
+	size_t width_chr() const;
+
+	/**
+	 * Number of rows of tiles
+	 */
+	size_t height_chr() const;
+
+	png::palette const & palette() const;
+
+	/**
+	 * Decodes the next row of tiles
+	 * Returns false once all rows have been read
+	 */
+	bool next_row();
+
+	/**
+	 * View of the row of tiles most recently decoded; its data is overwritten
+	 * by the next call to next_row()
+	 */
+	TileView tiles() const;
+
+private:
+	static void on_error(png_structp png, png_const_charp msg);
+	void close();
+
+	FILE * m_file;
+	png_structp m_png;
+	png_infop m_info;
+	std::string m_error;
+
+	size_t m_width;
+	size_t m_height_chr;
+	size_t m_rows_read;
+	png::palette m_palette;
+
+	// decoded pixel data for one row of tiles, 1 byte per pixel
+	std::vector<byte_t> m_pixels;
+};
+
+#endif
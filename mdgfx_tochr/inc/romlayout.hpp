@@ -0,0 +1,30 @@
+#ifndef MDGFX__ROMLAYOUT_H
+#define MDGFX__ROMLAYOUT_H
+
+#include <cstddef>
+#include <vector>
+
+// the VDP cannot DMA across a 128KB boundary in the source address
+constexpr std::size_t DMA_BOUNDARY { 0x20000 };
+
+// where each block of data goes within a packed ROM area
+struct RomLayout
+{
+	// offset of each block from the start of the area, in the original order
+	std::vector<std::size_t> offsets;
+
+	// total size of the area, including padding
+	std::size_t size;
+};
+
+/**
+ * Packs blocks of data (e.g. the CHR for each bank) into one area of ROM which
+ * starts at the given address, such that no block crosses a DMA boundary
+ * Blocks are placed largest first into the first boundary-to-boundary section
+ * with room left, which keeps the padding small
+ */
+RomLayout plan_rom_layout(std::vector<std::size_t> const & block_sizes,
+													std::size_t const rom_base = 0,
+													std::size_t const boundary = DMA_BOUNDARY);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MDGFX__TILEKERNELS_H
+#define MDGFX__TILEKERNELS_H
+
+#include "gfxdef.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * One version (scalar, SSE2 or AVX2) of the packed tile predicates and flips
+ */
+struct TileKernels
+{
+	char const * name;
+	bool (*is_blank_tile)(PackedChr const &);
+	bool (*is_flat_tile)(PackedChr const &);
+	bool (*is_identical_tile)(PackedChr const &, PackedChr const &);
+	void (*v_flip_tile)(PackedChr &);
+	void (*h_flip_tile)(PackedChr &);
+};
+
+/**
+ * All the versions this machine can run, scalar first and fastest last
+ */
+std::vector<TileKernels> available_kernels();
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef MDGFX__TILEMERGE_H
+#define MDGFX__TILEMERGE_H
+
+#include "gfxdef.hpp"
+#include "tileopt.hpp"
+#include <cstddef>
+
+// number of pixels in a tile, and so the most two tiles can differ by
+constexpr std::size_t PIXELS_PER_TILE { 64 };
+
+/**
+ * Merges tiles which differ by only a few pixels (under any flip) into one,
+ * which is lossy, but can fit an image into far fewer tiles than exact
+ * deduplication alone
+ * The closest tiles are merged first, until there are no more than max_tiles
+ * (if not 0) or nothing left within tolerance pixels of another tile; the
+ * map entries of a merged tile are pointed at the tile it was merged into,
+ * with the flips to best match it
+ * Throws if the tiles can't be brought within max_tiles
+ */
+void merge_near_duplicates(TileAnalysis & analysis, std::size_t const max_tiles,
+													 std::size_t const tolerance = PIXELS_PER_TILE);
+
+#endif
@@ -3,8 +3,10 @@
 
 #include "common.hpp"
 #include "gfxutils.hpp"
+#include "tileview.hpp"
 #include "zlib.h"
 #include <chrgfx/chrgfx.hpp>
+#include <unordered_map>
 #include <vector>
 
 enum TileType
@@ -39,19 +41,20 @@ struct TileOptInfo
 
 	/**
 	 * The index of this map entry within the source image
+	 * (this is also the index of the tile's data in the source TileView)
 	 */
-	u16 idx;
+	u32 idx;
 
 	/**
 	 * The index of this tile within the block of final, optimized tiles
 	 */
-	u16 idx_opt;
+	u32 idx_opt;
 
 	/**
 	 * If this tile is a duplcate, contains the idxOrig of the "master" tile
 	 * which is duplicates
 	 */
-	std::optional<u16> dupe_of_idx;
+	std::optional<u32> dupe_of_idx;
 
 	/**
 	 * The palette entry used if the tile is flat
@@ -68,21 +71,117 @@ struct TileOptInfo
 	 */
 	bool h_flip;
 
+	/**
+	 * CRC of the tile in its canonical orientation, which is shared by all
+	 * flipped copies of the tile
+	 */
 	ulong crc;
-	ulong crc_v_flip;
-	ulong crc_h_flip;
-	ulong crc_hv_flip;
 
-	byte_t * tile_data;
+	/**
+	 * Indicates the tile must be V flipped to be in its canonical orientation
+	 */
+	bool canon_v_flip;
+
+	/**
+	 * Indicates the tile must be H flipped to be in its canonical orientation
+	 */
+	bool canon_h_flip;
 
 	TileOptInfo();
 };
 
-std::vector<TileOptInfo> analyze(buffer<byte_t> const & src_tiles,
-																 std::size_t const start_chr,
-																 std::size_t const chr_count);
+/**
+ * The complete result of optimizing a block of tiles: the map entry info for
+ * each source tile and the unique tiles that make up the final CHR data
+ * This is generated once per image (or bank) and shared by all the outputs
+ */
+struct TileAnalysis
+{
+	std::vector<TileOptInfo> infolist;
+
+	// unique tiles, in optimized index order
+	std::vector<PackedChr> chrs;
+};
+
+/**
+ * Classifies and deduplicates tiles one at a time, keeping a copy of only the
+ * unique tiles
+ * This is used by analyze(), and directly when the source image is streamed
+ * in rather than decoded all at once
+ */
+class TileAnalyzer
+{
+public:
+	TileAnalyzer(std::size_t const start_chr = 0);
+
+	/**
+	 * Adds the next tile from the source
+	 */
+	void add(PackedChr const & chr);
 
-std::vector<byte_t *> filter_chrs(std::vector<TileOptInfo> const & mapInfoList);
+	/**
+	 * Adds all the tiles from another analyzer, whose tiles directly follow
+	 * the ones in this analyzer in the source image (or come from the next
+	 * source image, when several images share their tiles)
+	 */
+	void merge(TileAnalyzer const & other);
+
+	/**
+	 * Number of tiles added so far
+	 */
+	std::size_t size() const;
+
+	std::size_t start_chr() const;
+
+	/**
+	 * Assigns the final optimized indices; call once all tiles have been added
+	 */
+	void finish();
+
+	std::vector<TileOptInfo> const & infolist() const;
+
+	std::vector<PackedChr> filter_chrs() const;
+
+	/**
+	 * The infolist and unique tiles together; call after finish()
+	 */
+	TileAnalysis result() const;
+
+private:
+	// checks an already classified tile against the unique tiles seen so far
+	void append(TileOptInfo tileinfo, PackedChr const & chr);
+
+	// index within the source image of the first tile
+	std::size_t m_start_chr;
+
+	std::vector<TileOptInfo> m_infolist;
+
+	// data of each unique tile, in the order they were found...
+	std::vector<PackedChr> m_chrs;
+	// ...and the index of each one in the infolist
+	std::vector<u32> m_chr_owners;
+
+	// flat color -> infolist index of the master tile
+	std::unordered_map<u8, std::size_t> m_flat_masters;
+	// canonical CRC -> index in m_chrs of the master tile
+	std::unordered_multimap<ulong, std::size_t> m_normal_masters;
+};
+
+// minimum number of tiles handed to each thread by analyze()
+constexpr std::size_t MIN_SHARD_SIZE { 4096 };
+
+/**
+ * Adds a range of tiles to a new analyzer, splitting the work across threads
+ * for large ranges
+ * The analyzer is not finished, so more tiles can still be merged into it
+ */
+TileAnalyzer make_analyzer(TileView const & tiles, std::size_t const start_chr,
+													 std::size_t const chr_count,
+													 std::size_t const threads = 1);
+
+TileAnalysis analyze(TileView const & tiles, std::size_t const start_chr,
+										 std::size_t const chr_count,
+										 std::size_t const threads = 1);
 
 u16 make_nametable_entry(TileOptInfo tileInfo, u16 vramTileBase = 0);
 
@@ -93,10 +192,32 @@ std::vector<u16> make_optinfo_tilemap(std::vector<TileOptInfo> const & infolist,
 																			bool const priority = false,
 																			u16 const tile_base = 0);
 
+// ends a map in the Chirari RLE format
+constexpr u16 RLE_TERMINATOR { 0xffff };
+
+/**
+ * Encodes a range of map entries in the Chirari RLE format, in a single pass
+ * Runs of the same tile are up to 7 long and runs of blank tiles up to 0x1fff
+ * (debug builds also check that the result decodes back to the source)
+ */
 std::vector<u16> make_rle_tilemap(std::vector<TileOptInfo> const & infolist,
 																	std::size_t const index,
 																	std::size_t const length,
 																	std::size_t const tilemap_width,
 																	u16 const tile_base);
 
+// a tilemap in the Chirari RLE format, decoded
+struct RleTilemap
+{
+	std::size_t width;
+	// one entry per run, with the tile id including the tile base
+	std::vector<TilemapEntry> entries;
+};
+
+/**
+ * Decodes a map in the Chirari RLE format (in native byte order), up to the
+ * terminator
+ */
+RleTilemap decode_rle_tilemap(std::vector<u16> const & tilemap);
+
 #endif
@@ -0,0 +1,70 @@
+#ifndef MDGFX__TILEPOOL_H
+#define MDGFX__TILEPOOL_H
+
+#include "gfxdef.hpp"
+#include "tileopt.hpp"
+#include <vector>
+
+/**
+ * The unique tiles of a banked image, split into a resident set which stays in
+ * VRAM for every bank and the remainder which must be loaded for each bank
+ * A bank's remaining tiles are placed directly after the resident set, so the
+ * tile indices in the bank infolists cover both
+ */
+struct TilePool
+{
+	std::vector<PackedChr> resident;
+
+	// tiles to load for each bank, after the resident set
+	std::vector<std::vector<PackedChr>> bank_chrs;
+
+	// map entry info for each bank, with idx_opt in the combined index space
+	std::vector<std::vector<TileOptInfo>> bank_infolists;
+};
+
+/**
+ * Splits the tiles of an analysis covering a whole image into a resident set
+ * and per bank remainders, so that the resident set plus the largest bank's
+ * remainder fit within the VRAM budget (in tiles)
+ * Tiles used by the most banks are made resident first
+ */
+TilePool make_tile_pool(TileAnalysis const & analysis,
+												std::size_t const bank_size,
+												std::size_t const vram_budget);
+
+// a tile to copy into VRAM
+struct TileUpload
+{
+	// VRAM slot to copy to
+	u32 slot;
+	// index of the tile in FrameDeltas::chrs
+	u32 chr;
+};
+
+/**
+ * The tiles which need to be copied into a fixed set of VRAM slots before each
+ * frame (bank) of an animation is shown, given what the previous frames left
+ * in those slots
+ */
+struct FrameDeltas
+{
+	// all the tiles used by any frame, which the uploads are copied from
+	std::vector<PackedChr> chrs;
+
+	// uploads for each frame, in slot order
+	std::vector<std::vector<TileUpload>> uploads;
+
+	// map entry info for each frame, with idx_opt set to the VRAM slot
+	std::vector<std::vector<TileOptInfo>> frame_infolists;
+};
+
+/**
+ * Assigns the unique tiles used in each frame to VRAM slots, reusing whatever
+ * is already in a slot when possible, so that the fewest tiles are uploaded
+ * in total
+ */
+FrameDeltas make_frame_deltas(TileAnalysis const & analysis,
+															std::size_t const frame_size,
+															std::size_t const slot_count);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MDGFX__TILEVIEW_H
+#define MDGFX__TILEVIEW_H
+
+#include "gfxdef.hpp"
+#include <png++/png.hpp>
+#include <vector>
+
+/**
+ * Provides access to the tiles of an image in place, reading straight from
+ * its scanlines rather than from a re-tiled copy of the pixel data
+ * The image must outlive the view
+ */
+class TileView
+{
+public:
+	TileView(png::pixel_buffer<png::index_pixel> const & pixbuf);
+
+	/**
+	 * View over a set of scanlines (1 byte per pixel) of the given pixel width
+	 */
+	TileView(std::vector<byte_t const *> const & rows, size_t width);
+
+	/**
+	 * Number of tiles in each row of tiles
+	 */
+	size_t width() const;
+
+	/**
+	 * Number of rows of tiles
+	 */
+	size_t height() const;
+
+	/**
+	 * Total number of tiles
+	 */
+	size_t size() const;
+
+	/**
+	 * Copies the specified tile out as a basic (1 byte per pixel) tile
+	 */
+	void get_basic(size_t chr_idx, byte_t * out) const;
+
+	/**
+	 * Returns the specified tile as a packed (4bpp) tile
+	 */
+	PackedChr get_packed(size_t chr_idx) const;
+
+private:
+	// pointers to the start of each scanline
+	std::vector<byte_t const *> m_rows;
+	size_t m_width_chr;
+	size_t m_height_chr;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef MDGFX__WORKPOOL_H
+#define MDGFX__WORKPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs work(0) through work(count - 1) across the given number of threads
+ * Any exception thrown by the work is rethrown once all threads are done
+ */
+inline void parallel_for(size_t const count, size_t const jobs,
+												 std::function<void(size_t)> const & work)
+{
+	size_t const thread_count { std::max<size_t>(1, std::min(jobs, count)) };
+	if(thread_count == 1)
+	{
+		for(size_t this_job { 0 }; this_job < count; ++this_job)
+			work(this_job);
+		return;
+	}
+
+	std::atomic<size_t> next_job { 0 };
+	std::exception_ptr error;
+	std::mutex error_lock;
+
+	auto worker = [&]() {
+		size_t this_job;
+		while((this_job = next_job++) < count)
+		{
+			try
+			{
+				work(this_job);
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock { error_lock };
+				if(!error)
+					error = std::current_exception();
+				// no point in starting anything else
+				next_job = count;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(size_t this_thread { 0 }; this_thread < thread_count; ++this_thread)
+		threads.emplace_back(worker);
+	for(auto & thread : threads)
+		thread.join();
+
+	if(error)
+		std::rethrow_exception(error);
+}
+
+/**
+ * Runs work(0) through work(count - 1) across the given number of threads,
+ * passing each result to output on the calling thread strictly in index
+ * order, as soon as it and all the results before it are ready
+ */
+template <typename ResultT>
+void parallel_ordered(size_t const count, size_t const jobs,
+											std::function<ResultT(size_t)> const & work,
+											std::function<void(size_t, ResultT &)> const & output)
+{
+	size_t const thread_count { std::max<size_t>(1, std::min(jobs, count)) };
+	if(thread_count == 1)
+	{
+		for(size_t this_job { 0 }; this_job < count; ++this_job)
+		{
+			ResultT result { work(this_job) };
+			output(this_job, result);
+		}
+		return;
+	}
+
+	std::vector<std::optional<ResultT>> results(count);
+	std::atomic<size_t> next_job { 0 };
+	std::exception_ptr error;
+	std::mutex results_lock;
+	std::condition_variable result_ready;
+
+	auto worker = [&]() {
+		size_t this_job;
+		while((this_job = next_job++) < count)
+		{
+			try
+			{
+				ResultT result { work(this_job) };
+				std::lock_guard<std::mutex> lock { results_lock };
+				results[this_job] = std::move(result);
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock { results_lock };
+				if(!error)
+					error = std::current_exception();
+				next_job = count;
+			}
+			result_ready.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(size_t this_thread { 0 }; this_thread < thread_count; ++this_thread)
+		threads.emplace_back(worker);
+
+	for(size_t this_job { 0 }; this_job < count; ++this_job)
+	{
+		std::unique_lock<std::mutex> lock { results_lock };
+		result_ready.wait(
+				lock, [&]() { return results[this_job].has_value() || error; });
+		if(error)
+			break;
+		ResultT result { std::move(*results[this_job]) };
+		results[this_job].reset();
+		lock.unlock();
+
+		try
+		{
+			output(this_job, result);
+		}
+		catch(...)
+		{
+			lock.lock();
+			error = std::current_exception();
+			next_job = count;
+			break;
+		}
+	}
+
+	for(auto & thread : threads)
+		thread.join();
+
+	if(error)
+		std::rethrow_exception(error);
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "bankmanifest.hpp"
+#include "zlib.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+namespace
+{
+u32 crc_of(string const & data)
+{
+	return crc32(crc32(0L, Z_NULL, 0), (Bytef const *)data.data(),
+							 (uInt)data.size());
+}
+} // namespace
+
+BankManifest::ContentHash::ContentHash() :
+		size(0), crc(crc32(0L, Z_NULL, 0)), adler(adler32(0L, Z_NULL, 0))
+{
+}
+
+void BankManifest::ContentHash::add(u8 const * data, size_t length)
+{
+	size += length;
+	crc = crc32(crc, (Bytef const *)data, (uInt)length);
+	adler = adler32(adler, (Bytef const *)data, (uInt)length);
+}
+
+bool BankManifest::ContentHash::operator==(ContentHash const & other) const
+{
+	return size == other.size && crc == other.crc && adler == other.adler;
+}
+
+BankManifest::BankManifest(string const & path, string const & settings) :
+		m_settings_crc(crc_of(settings)), m_have_previous(false)
+{
+	// the manifest is just a hint, so anything missing or unreadable means
+	// everything gets rebuilt
+	ifstream manifest_in { path };
+	if(!manifest_in.good())
+		return;
+
+	auto read_hash { [](istream & fields, ContentHash & hash) {
+		return (bool)(fields >> hash.crc >> hash.adler >> hash.size);
+	} };
+
+	// the outputs come last and are read even if the settings have changed, as
+	// that's when the set of files is most likely to be different
+	bool same_settings { false }, have_image { false }, banks_good { true };
+	string line;
+	while(getline(manifest_in, line))
+	{
+		istringstream fields { line };
+		string name;
+		fields >> name >> hex;
+		if(name == "settings")
+		{
+			u32 value;
+			same_settings = fields >> value && value == m_settings_crc;
+		}
+		else if(name == "image")
+			have_image = read_hash(fields, m_previous_image);
+		else if(name == "bank")
+		{
+			// a bad bank record would shift all the ones after it
+			ContentHash bank;
+			banks_good = banks_good && read_hash(fields, bank);
+			m_previous_banks.push_back(bank);
+		}
+		else if(name == "output")
+		{
+			// (only ever a suffix, never anywhere else)
+			string suffix;
+			if(fields >> suffix && suffix.front() == '.' &&
+				 suffix.find('/') == string::npos)
+				m_previous_outputs.push_back(suffix);
+		}
+	}
+
+	m_have_previous = same_settings && have_image && banks_good;
+}
+
+void BankManifest::update(TileView const & tiles, size_t const bank_size)
+{
+	size_t const bank_count { bank_size > 0 ? tiles.size() / bank_size : 0 };
+
+	// one pass over the tiles for both the image and the bank hashes
+	m_image = ContentHash();
+	m_banks.assign(bank_count, ContentHash());
+	for(size_t this_chr { 0 }; this_chr < tiles.size(); ++this_chr)
+	{
+		PackedChr const chr { tiles.get_packed(this_chr) };
+		m_image.add((u8 const *)&chr, PACKED_CHR_BYTESZ);
+
+		size_t const bankidx { bank_size > 0 ? this_chr / bank_size : 0 };
+		if(bankidx < bank_count)
+			m_banks[bankidx].add((u8 const *)&chr, PACKED_CHR_BYTESZ);
+	}
+}
+
+bool BankManifest::image_unchanged() const
+{
+	return m_have_previous && m_previous_image == m_image;
+}
+
+bool BankManifest::bank_unchanged(size_t const bankidx) const
+{
+	return m_have_previous && bankidx < m_previous_banks.size() &&
+				 bankidx < m_banks.size() &&
+				 m_previous_banks[bankidx] == m_banks[bankidx];
+}
+
+vector<string> const & BankManifest::previous_outputs() const
+{
+	return m_previous_outputs;
+}
+
+void BankManifest::set_outputs(vector<string> const & suffixes)
+{
+	m_outputs = suffixes;
+}
+
+string BankManifest::str() const
+{
+	stringstream ss;
+	ss << hex << setfill('0');
+	ss << "settings " << setw(8) << m_settings_crc << '\n';
+	auto write_hash { [&ss](ContentHash const & hash) {
+		ss << setw(8) << hash.crc << ' ' << setw(8) << hash.adler << ' '
+			 << hash.size << '\n';
+	} };
+	ss << "image ";
+	write_hash(m_image);
+	for(auto const & bank : m_banks)
+	{
+		ss << "bank ";
+		write_hash(bank);
+	}
+	for(auto const & suffix : m_outputs)
+		ss << "output " << suffix << '\n';
+	return ss.str();
+}
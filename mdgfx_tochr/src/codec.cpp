@@ -0,0 +1,120 @@
+#include "codec.hpp"
+#include "comper.hpp"
+#include "enigma.hpp"
+#include "kosinski.hpp"
+#include "nemesis.hpp"
+#include "workpool.hpp"
+#include <stdexcept>
+
+using namespace std;
+
+string codec_name(Codec const codec)
+{
+	switch(codec)
+	{
+		case CODEC_NEMESIS:
+			return "nemesis";
+		case CODEC_ENIGMA:
+			return "enigma";
+		case CODEC_KOSINSKI:
+			return "kosinski";
+		case CODEC_COMPER:
+			return "comper";
+		default:
+			return "none";
+	}
+}
+
+bool can_pack(Codec const codec, size_t const size)
+{
+	switch(codec)
+	{
+		case CODEC_NEMESIS:
+			return nemesis_fits(size);
+		case CODEC_ENIGMA:
+		case CODEC_COMPER:
+			return size % 2 == 0;
+		default:
+			return true;
+	}
+}
+
+Packed pack(Codec const codec, string const & data, size_t const threads)
+{
+	Packed packed { codec, data, 0 };
+	if(codec == CODEC_NONE)
+		return packed;
+
+	u8 const * in { (u8 const *)data.data() };
+	vector<u8> encoded, decoded;
+	switch(codec)
+	{
+		case CODEC_NEMESIS:
+			encoded = nemesis_encode(in, data.size(), threads);
+			decoded = nemesis_decode(encoded.data(), encoded.size(), &packed.cycles);
+			break;
+
+		case CODEC_ENIGMA:
+		{
+			// Enigma works on whole (native order) entries
+			vector<u16> map(data.size() / 2);
+			for(size_t this_entry { 0 }; this_entry < map.size(); ++this_entry)
+				map[this_entry] = (in[this_entry * 2] << 8) | in[this_entry * 2 + 1];
+			encoded = enigma_encode(map);
+			for(auto const entry : enigma_decode(encoded.data(), encoded.size(),
+																					 &packed.cycles))
+			{
+				decoded.push_back((u8)(entry >> 8));
+				decoded.push_back((u8)entry);
+			}
+			break;
+		}
+
+		case CODEC_KOSINSKI:
+			encoded = kosinski_encode(in, data.size());
+			decoded = kosinski_decode(encoded.data(), encoded.size(), &packed.cycles);
+			break;
+
+		case CODEC_COMPER:
+			encoded = comper_encode(in, data.size());
+			decoded = comper_decode(encoded.data(), encoded.size(), &packed.cycles);
+			break;
+
+		default:
+			break;
+	}
+
+	// the data has to be decompressed for the cycle count anyway, so make sure
+	// it comes back the same while we're at it
+	if(decoded != vector<u8>(data.begin(), data.end()))
+		throw runtime_error(codec_name(codec) +
+												" output does not decompress to the source");
+
+	packed.data.assign(encoded.begin(), encoded.end());
+	return packed;
+}
+
+Packed pack_best(vector<Codec> const & codecs, string const & data,
+								 size_t const byte_cost, size_t const threads)
+{
+	vector<Codec> usable;
+	for(auto const codec : codecs)
+		if(can_pack(codec, data.size()))
+			usable.push_back(codec);
+
+	vector<Packed> results(usable.size());
+	parallel_for(usable.size(), threads, [&](size_t this_codec) {
+		results[this_codec] = pack(usable[this_codec], data);
+	});
+
+	auto cost = [byte_cost](Packed const & packed) {
+		return packed.data.size() * byte_cost + packed.cycles;
+	};
+	size_t best { 0 };
+	for(size_t this_codec { 1 }; this_codec < results.size(); ++this_codec)
+	{
+		if(cost(results[this_codec]) < cost(results[best]))
+			best = this_codec;
+	}
+	return results.at(best);
+}
@@ -0,0 +1,166 @@
+#include "comper.hpp"
+#include "lzmatch.hpp"
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+// Comper format:
+// description words, big endian and used high bit first, each one read
+// before the data for its 16 bits
+//  0 - a literal word follows
+//  1 - two bytes follow, d and n: copy n+1 words from 0x100-d words back, or
+//      if n is 0, the data ends
+// copies may overlap the words they write
+
+constexpr size_t MAX_DISTANCE { 0x100 };
+constexpr size_t MAX_COPY { 0x100 };
+
+// 68000 cycles for each part of the standard decompressor (ComperDec), from
+// the timings of the instructions involved
+constexpr size_t CYCLES_BIT { 12 };
+constexpr size_t CYCLES_DESCRIPTION { 22 };
+constexpr size_t CYCLES_LITERAL { 22 };
+constexpr size_t CYCLES_COPY { 48 };
+constexpr size_t CYCLES_COPY_WORD { 22 };
+constexpr size_t CYCLES_COPY_END { 24 };
+
+class DescriptionWriter
+{
+public:
+	DescriptionWriter(vector<u8> & out) : m_out(out), m_field(0), m_bitcount(0)
+	{
+	}
+
+	void put(u32 bit)
+	{
+		// a new word is only started once there's something to describe
+		if(m_bitcount == 0)
+		{
+			m_field = m_out.size();
+			m_out.push_back(0);
+			m_out.push_back(0);
+		}
+		if(bit)
+			m_out[m_field + m_bitcount / 8] |= 0x80 >> (m_bitcount % 8);
+		m_bitcount = (m_bitcount + 1) % 16;
+	}
+
+private:
+	vector<u8> & m_out;
+	size_t m_field;
+	size_t m_bitcount;
+};
+
+} // namespace
+
+vector<u8> comper_encode(u8 const * data, size_t size)
+{
+	if(size % 2 != 0)
+		throw invalid_argument("Comper data must be a whole number of words");
+
+	size_t const count { size / 2 };
+	auto const matches { find_lz_matches(data, size, 2, MAX_DISTANCE, MAX_COPY) };
+
+	// a literal and a copy are the same size, so the fewest steps is the
+	// smallest output
+	vector<size_t> cost(count + 1, 0);
+	vector<LzMatch> step(count);
+	for(size_t pos { count }; pos-- > 0;)
+	{
+		cost[pos] = 1 + cost[pos + 1];
+		step[pos] = LzMatch { 1, 0 };
+
+		size_t shorter { 1 };
+		for(auto const & match : matches[pos])
+		{
+			for(size_t length { shorter + 1 }; length <= match.length; ++length)
+			{
+				if(1 + cost[pos + length] < cost[pos])
+				{
+					cost[pos] = 1 + cost[pos + length];
+					step[pos] = LzMatch { length, match.distance };
+				}
+			}
+			shorter = match.length;
+		}
+	}
+
+	vector<u8> out;
+	DescriptionWriter desc { out };
+	for(size_t pos { 0 }; pos < count; pos += step[pos].length)
+	{
+		if(step[pos].length == 1)
+		{
+			desc.put(0);
+			out.push_back(data[pos * 2]);
+			out.push_back(data[pos * 2 + 1]);
+		}
+		else
+		{
+			desc.put(1);
+			out.push_back((u8)(MAX_DISTANCE - step[pos].distance));
+			out.push_back((u8)(step[pos].length - 1));
+		}
+	}
+
+	// end of data
+	desc.put(1);
+	out.push_back(0);
+	out.push_back(0);
+
+	return out;
+}
+
+vector<u8> comper_decode(u8 const * data, size_t size, size_t * cycles)
+{
+	size_t pos { 0 }, spent { 0 };
+	auto next_byte = [&]() {
+		if(pos >= size)
+			throw runtime_error("Comper data ends early");
+		return data[pos++];
+	};
+
+	u16 field { 0 };
+	size_t bits_left { 0 };
+	vector<u8> out;
+	while(true)
+	{
+		if(bits_left == 0)
+		{
+			field = next_byte() << 8;
+			field |= next_byte();
+			bits_left = 16;
+			spent += CYCLES_DESCRIPTION;
+		}
+		bool const copy { (field & 0x8000) != 0 };
+		field <<= 1;
+		--bits_left;
+		spent += CYCLES_BIT;
+
+		if(!copy)
+		{
+			out.push_back(next_byte());
+			out.push_back(next_byte());
+			spent += CYCLES_LITERAL;
+			continue;
+		}
+
+		u8 const offset { next_byte() }, length { next_byte() };
+		spent += CYCLES_COPY;
+		if(length == 0)
+			break;
+
+		size_t const distance { (MAX_DISTANCE - offset) * 2 };
+		if(distance > out.size())
+			throw runtime_error("Comper data copies from before the start");
+		for(size_t this_byte { 0 }; this_byte < (length + 1u) * 2; ++this_byte)
+			out.push_back(out[out.size() - distance]);
+		spent += CYCLES_COPY_WORD * (length + 1) + CYCLES_COPY_END;
+	}
+
+	if(cycles != nullptr)
+		*cycles = spent;
+	return out;
+}
@@ -1,71 +1,68 @@
 
-
 #include "gfxutils.hpp"
-#include "/home/ryou/Projects/lib/endian.hpp"
+#include "byteorder.hpp"
+#include "tilekernels.hpp"
+#include <algorithm>
 
 using namespace std;
 using namespace chrgfx;
 using namespace png;
 
-bool is_blank_tile(byte_t const * chr)
+namespace
+{
+// the fastest versions of the packed tile functions this machine can run,
+// chosen once at startup
+TileKernels const kernels { available_kernels().back() };
+} // namespace
+
+bool is_blank_tile(PackedChr const & chr)
+{
+	return kernels.is_blank_tile(chr);
+}
+
+bool is_flat_tile(PackedChr const & chr)
 {
-	for(u8 pixel_iter { 0 }; pixel_iter < BASIC_CHR_BYTESZ; ++pixel_iter)
-		if(chr[pixel_iter] != 0)
-			return false;
-	return true;
+	return kernels.is_flat_tile(chr);
 }
 
-bool is_flat_tile(byte_t const * chr)
+bool is_identical_tile(PackedChr const & chr1, PackedChr const & chr2)
 {
-	u8 flatval = *chr;
-	for(u8 pixel_iter { 1 }; pixel_iter < BASIC_CHR_BYTESZ; ++pixel_iter)
-		if(chr[pixel_iter] != flatval)
-			return false;
-	return true;
+	return kernels.is_identical_tile(chr1, chr2);
 }
 
-bool is_identical_tile(byte_t const * chr1, byte_t const * chr2)
+void v_flip_tile(PackedChr & chr)
 {
-	for(u8 pixel_iter { 0 }; pixel_iter < BASIC_CHR_BYTESZ; ++pixel_iter)
-		if(chr1[pixel_iter] != chr2[pixel_iter])
-			return false;
-	return true;
+	kernels.v_flip_tile(chr);
 }
 
-void v_flip_tile(byte_t * chr)
+void h_flip_tile(PackedChr & chr)
 {
-	int const swapcount { (int)BASIC_CHR_HEIGHT / 2 };
-	byte_t * row1_offset { nullptr };
-	byte_t * row2_offset { nullptr };
+	kernels.h_flip_tile(chr);
+}
 
-	for(byte_t this_rowswap { 0 }; this_rowswap < swapcount; ++this_rowswap)
+void encode_md_chr(PackedChr const & chr, u8 * out)
+{
+	// packed tiles are already in MD format, just need to write the rows
+	// big endian
+	for(auto row : chr.rows)
 	{
-		row1_offset = chr + (this_rowswap * BASIC_CHR_WIDTH);
-		row2_offset = chr + ((7 - this_rowswap) * BASIC_CHR_WIDTH);
-		swap_ranges(row1_offset, row1_offset + BASIC_CHR_WIDTH, row2_offset);
+		*out++ = row >> 24;
+		*out++ = row >> 16;
+		*out++ = row >> 8;
+		*out++ = row;
 	}
 }
 
-void h_flip_tile(byte_t * chr)
+void encode_md_chrs(byte_t const * chrs, size_t count, u8 * out)
 {
-	int const swapcount { (int)BASIC_CHR_WIDTH / 2 };
-	// u8* pxl1_offset{nullptr};
-	// u8* pxl2_offset{nullptr};
-	size_t pxl1_offset { 0 };
-	size_t pxl2_offset { 0 };
-	// two loops, one for each row
-	// inner loop for each pixel swap in that row
-	for(u8 this_row { 0 }; this_row < BASIC_CHR_HEIGHT; ++this_row)
+	// this is the same conversion encode_chr does with MD_CHR, with the layout
+	// fixed: basic tiles and MD tiles share the same pixel order, so every two
+	// pixels become one byte with the leftmost in the high nibble
+	byte_t const * chrs_end { chrs + (count * BASIC_CHR_BYTESZ) };
+	while(chrs != chrs_end)
 	{
-		for(u8 this_pxlswap { 0 }; this_pxlswap < swapcount; ++this_pxlswap)
-		{
-			// pxl1_offset = chr + (this_row * CHR_WIDTH) + this_pxlswap;
-			// pxl2_offset = chr + (this_row * CHR_WIDTH) + (7 - this_pxlswap);
-
-			pxl1_offset = (this_row * BASIC_CHR_WIDTH) + this_pxlswap;
-			pxl2_offset = (this_row * BASIC_CHR_WIDTH) + (7 - this_pxlswap);
-			std::swap(chr[pxl1_offset], chr[pxl2_offset]);
-		}
+		*out++ = (u8)((chrs[0] & 0xf) << 4) | (chrs[1] & 0xf);
+		chrs += 2;
 	}
 }
 
@@ -77,58 +74,66 @@ void dump_md_palette(palette const & pal, ostream & out)
 	out_pal.reset();
 }
 
-void dump_md_tiles(buffer<byte_t> const & bank, ostream & out)
+void dump_md_tiles(TileView const & bank, ostream & out)
 {
-	dump_md_tiles(bank, out, 0, bank.size<byte_t[BASIC_CHR_BYTESZ]>());
+	dump_md_tiles(bank, out, 0, bank.size());
 }
 
-void dump_md_tiles(buffer<byte_t> const & bank, ostream & out, size_t index,
+void dump_md_tiles(TileView const & bank, ostream & out, size_t index,
 									 size_t length)
 {
-	uptr<byte_t> chr;
-	auto i_tile = bank.begin<byte_t[64]>() + index;
-	auto i_tile_end = i_tile + length;
-	while(i_tile != i_tile_end)
+	// encode the whole range into one block and write it out in one go
+	byte_t chr[BASIC_CHR_BYTESZ];
+	vector<u8> out_chrs(length * MD_CHR_BYTESZ);
+	u8 * out_chr { out_chrs.data() };
+	for(size_t this_chr { index }; this_chr < index + length; ++this_chr)
 	{
-		chr.reset(encode_chr(MD_CHR, *i_tile));
-		out.write((char *)chr.get(), MD_CHR_BYTESZ / 8);
-		++i_tile;
+		bank.get_basic(this_chr, chr);
+		encode_md_chrs(chr, 1, out_chr);
+
+#ifdef DEBUG
+		// make sure we match the generic chrgfx encoder
+		uptr<byte_t> check_chr { encode_chr(MD_CHR, chr) };
+		if(!equal(check_chr.get(), check_chr.get() + MD_CHR_BYTESZ, out_chr))
+			throw runtime_error("MD tile encoder output does not match chrgfx");
+#endif
+
+		out_chr += MD_CHR_BYTESZ;
 	}
-	chr.reset();
+
+	out.write((char *)out_chrs.data(), out_chrs.size());
 }
 
-void dump_md_tiles(vector<byte_t *> const & bank, ostream & out)
+void dump_md_tiles(vector<PackedChr> const & bank, ostream & out)
 {
 	dump_md_tiles(bank, out, 0, bank.size());
 }
 
-void dump_md_tiles(vector<byte_t *> const & bank, ostream & out, size_t index,
+void dump_md_tiles(vector<PackedChr> const & bank, ostream & out, size_t index,
 									 size_t length)
 {
-	uptr<byte_t> chr;
-	// auto i_tile = bank.begin<byte_t[64]>() + index;
-	// auto i_tile_end = i_tile + length;
-	// while(i_tile != i_tile_end)
-	for(auto ptr_tile : bank)
+	vector<u8> out_chrs(length * MD_CHR_BYTESZ);
+	u8 * out_chr { out_chrs.data() };
+	auto i_tile = bank.begin() + index;
+	auto i_tile_end = i_tile + length;
+	while(i_tile != i_tile_end)
 	{
-		chr.reset(encode_chr(MD_CHR, ptr_tile));
-		out.write((char *)chr.get(), MD_CHR_BYTESZ);
+		encode_md_chr(*i_tile, out_chr);
+		out_chr += MD_CHR_BYTESZ;
+		++i_tile;
 	}
-	chr.reset();
+	out.write((char *)out_chrs.data(), out_chrs.size());
 }
 
 void dump_md_tilemap(vector<u16> const & map, ostream & out)
 {
-	auto copy = endian_copy_func(true);
-	u8 temp_buffer[2];
-	for(auto entry : map)
-	{
-		copy((u8 *)&entry, (u8 *)&entry + 2, temp_buffer);
-		out.write((char const *)temp_buffer, 2);
-	}
+	// swap a copy of the whole map and write it out in one go
+	vector<u16> out_map(map);
+	md_byte_order(out_map.data(), out_map.size());
+	out.write((char const *)out_map.data(), out_map.size() * sizeof(u16));
 }
 
-u16 make_nametable_entry(u16 tile_index, enum VDPPal const pal_line,
+u16 make_nametable_entry(u32 tile_index, enum VDPPal const pal_line,
 												 bool const priority, bool const h_flip,
 												 bool const v_flip)
 {
@@ -0,0 +1,235 @@
+#include "kosinski.hpp"
+#include "lzmatch.hpp"
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+// Kosinski format:
+// description fields of 16 bits, stored little endian and used low bit
+// first, mixed in with the data bytes; the next field is read as soon as the
+// last bit of the one before it is used, ahead of any data for that bit
+//  1 - a literal byte follows
+//  00 ll - copy l+2 bytes from 0x100-d back, with byte d following
+//  01 - copy with two bytes following, dddddddd dddddlll:
+//       l>0: copy l+2 bytes from 0x2000-d back
+//       l=0: a third byte n follows: copy n+1 bytes, or 0 ends the data and
+//       1 does nothing
+// copies may overlap the bytes they write
+
+constexpr size_t MAX_INLINE_DISTANCE { 0x100 };
+constexpr size_t MAX_INLINE_COPY { 5 };
+constexpr size_t MAX_DISTANCE { 0x2000 };
+constexpr size_t MAX_SHORT_COPY { 9 };
+constexpr size_t MAX_COPY { 0x100 };
+
+// size of each encoding in bits, counting its description bits
+constexpr size_t LITERAL_BITS { 1 + 8 };
+constexpr size_t INLINE_COPY_BITS { 4 + 8 };
+constexpr size_t SHORT_COPY_BITS { 2 + 16 };
+constexpr size_t LONG_COPY_BITS { 2 + 24 };
+
+// 68000 cycles for each part of the standard decompressor (KosDec), from the
+// timings of the instructions involved, not counting the description bits
+constexpr size_t CYCLES_BIT { 46 };
+constexpr size_t CYCLES_RELOAD { 40 };
+constexpr size_t CYCLES_LITERAL { 22 };
+constexpr size_t CYCLES_INLINE_COPY { 50 };
+constexpr size_t CYCLES_COPY { 76 };
+constexpr size_t CYCLES_LONG_COPY { 36 };
+constexpr size_t CYCLES_COPY_BYTE { 32 };
+constexpr size_t CYCLES_COPY_END { 24 };
+
+// 0 if the copy can't be encoded
+size_t copy_bits(size_t const length, size_t const distance)
+{
+	if(length <= MAX_INLINE_COPY && distance <= MAX_INLINE_DISTANCE)
+		return INLINE_COPY_BITS;
+	if(length < 3)
+		return 0;
+	return length <= MAX_SHORT_COPY ? SHORT_COPY_BITS : LONG_COPY_BITS;
+}
+
+class DescriptionWriter
+{
+public:
+	DescriptionWriter(vector<u8> & out) : m_out(out), m_field(0), m_bitcount(0)
+	{
+		start_field();
+	}
+
+	void put(u32 bit)
+	{
+		if(bit)
+			m_out[m_field + m_bitcount / 8] |= 1 << (m_bitcount % 8);
+		if(++m_bitcount == 16)
+			start_field();
+	}
+
+private:
+	void start_field()
+	{
+		m_field = m_out.size();
+		m_bitcount = 0;
+		m_out.push_back(0);
+		m_out.push_back(0);
+	}
+
+	vector<u8> & m_out;
+	size_t m_field;
+	size_t m_bitcount;
+};
+
+} // namespace
+
+vector<u8> kosinski_encode(u8 const * data, size_t size)
+{
+	auto const matches { find_lz_matches(data, size, 1, MAX_DISTANCE, MAX_COPY) };
+
+	// working back from the end, the fewest bits needed for the rest of the data
+	// from each position, and the length of the step taken there (1 for a
+	// literal)
+	vector<size_t> cost(size + 1, 0);
+	vector<LzMatch> step(size);
+	for(size_t pos { size }; pos-- > 0;)
+	{
+		cost[pos] = LITERAL_BITS + cost[pos + 1];
+		step[pos] = LzMatch { 1, 0 };
+
+		size_t shorter { 1 };
+		for(auto const & match : matches[pos])
+		{
+			for(size_t length { shorter + 1 }; length <= match.length; ++length)
+			{
+				size_t const bits { copy_bits(length, match.distance) };
+				if(bits > 0 && bits + cost[pos + length] < cost[pos])
+				{
+					cost[pos] = bits + cost[pos + length];
+					step[pos] = LzMatch { length, match.distance };
+				}
+			}
+			shorter = match.length;
+		}
+	}
+
+	vector<u8> out;
+	DescriptionWriter desc { out };
+	for(size_t pos { 0 }; pos < size; pos += step[pos].length)
+	{
+		size_t const length { step[pos].length }, distance { step[pos].distance };
+		if(length == 1)
+		{
+			desc.put(1);
+			out.push_back(data[pos]);
+		}
+		else if(copy_bits(length, distance) == INLINE_COPY_BITS)
+		{
+			desc.put(0);
+			desc.put(0);
+			desc.put((length - 2) >> 1);
+			desc.put((length - 2) & 1);
+			out.push_back((u8)(MAX_INLINE_DISTANCE - distance));
+		}
+		else
+		{
+			desc.put(0);
+			desc.put(1);
+			size_t const offset { MAX_DISTANCE - distance };
+			out.push_back((u8)offset);
+			if(length <= MAX_SHORT_COPY)
+				out.push_back((u8)(((offset >> 5) & 0xf8) | (length - 2)));
+			else
+			{
+				out.push_back((u8)((offset >> 5) & 0xf8));
+				out.push_back((u8)(length - 1));
+			}
+		}
+	}
+
+	// end of data
+	desc.put(0);
+	desc.put(1);
+	out.push_back(0x00);
+	out.push_back(0xf0);
+	out.push_back(0x00);
+
+	return out;
+}
+
+vector<u8> kosinski_decode(u8 const * data, size_t size, size_t * cycles)
+{
+	size_t pos { 0 }, spent { 0 };
+	auto next_byte = [&]() {
+		if(pos >= size)
+			throw runtime_error("Kosinski data ends early");
+		return data[pos++];
+	};
+
+	u16 field { 0 };
+	size_t bits_left { 0 };
+	auto reload = [&]() {
+		field = next_byte();
+		field |= next_byte() << 8;
+		bits_left = 16;
+		spent += CYCLES_RELOAD;
+	};
+	auto next_bit = [&]() {
+		u32 const bit { field & 1u };
+		field >>= 1;
+		spent += CYCLES_BIT;
+		if(--bits_left == 0)
+			reload();
+		return bit;
+	};
+
+	reload();
+	vector<u8> out;
+	while(true)
+	{
+		if(next_bit())
+		{
+			out.push_back(next_byte());
+			spent += CYCLES_LITERAL;
+			continue;
+		}
+
+		size_t length, distance;
+		if(!next_bit())
+		{
+			length = next_bit() << 1;
+			length |= next_bit();
+			length += 2;
+			distance = MAX_INLINE_DISTANCE - next_byte();
+			spent += CYCLES_INLINE_COPY;
+		}
+		else
+		{
+			u8 const low { next_byte() }, high { next_byte() };
+			distance = MAX_DISTANCE - (((high & 0xf8) << 5) | low);
+			spent += CYCLES_COPY;
+			if(high & 7)
+				length = (high & 7) + 2;
+			else
+			{
+				u8 const count { next_byte() };
+				spent += CYCLES_LONG_COPY;
+				if(count == 0)
+					break;
+				if(count == 1)
+					continue;
+				length = count + 1;
+			}
+		}
+
+		if(distance > out.size())
+			throw runtime_error("Kosinski data copies from before the start");
+		for(size_t this_byte { 0 }; this_byte < length; ++this_byte)
+			out.push_back(out[out.size() - distance]);
+		spent += CYCLES_COPY_BYTE * length + CYCLES_COPY_END;
+	}
+
+	if(cycles != nullptr)
+		*cycles = spent;
+	return out;
+}
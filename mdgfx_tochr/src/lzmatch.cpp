@@ -0,0 +1,60 @@
+#include "lzmatch.hpp"
+#include <limits>
+
+using namespace std;
+
+namespace
+{
+constexpr size_t HASH_BITS { 15 };
+constexpr size_t NO_POSITION { numeric_limits<size_t>::max() };
+// earlier positions with the same hash are checked only this far back, which
+// keeps long runs of the same value from taking forever
+constexpr size_t MAX_CHAIN { 256 };
+} // namespace
+
+vector<vector<LzMatch>> find_lz_matches(u8 const * data, size_t size,
+																				size_t unit_size, size_t window,
+																				size_t max_length)
+{
+	size_t const count { size / unit_size };
+	vector<vector<LzMatch>> matches(count);
+
+	// positions are chained by the hash of their first two units
+	auto hash_at = [&](size_t pos) {
+		u32 hash { 0 };
+		for(size_t this_byte { 0 }; this_byte < unit_size * 2; ++this_byte)
+			hash = hash * 0x9e3779b1u + data[pos * unit_size + this_byte];
+		return (hash ^ (hash >> 15)) & ((1u << HASH_BITS) - 1);
+	};
+	vector<size_t> head(1 << HASH_BITS, NO_POSITION), prev(count, NO_POSITION);
+
+	for(size_t pos { 0 }; pos + 1 < count; ++pos)
+	{
+		u32 const hash { hash_at(pos) };
+		size_t const longest { min(max_length, count - pos) * unit_size };
+
+		size_t best { 1 }, depth { 0 };
+		for(size_t from { head[hash] };
+				from != NO_POSITION && pos - from <= window && depth < MAX_CHAIN;
+				from = prev[from], ++depth)
+		{
+			u8 const * a { data + from * unit_size }, * b { data + pos * unit_size };
+			size_t same { 0 };
+			while(same < longest && a[same] == b[same])
+				++same;
+			size_t const length { same / unit_size };
+			if(length > best)
+			{
+				matches[pos].push_back(LzMatch { length, pos - from });
+				best = length;
+				if(same == longest)
+					break;
+			}
+		}
+
+		prev[pos] = head[hash];
+		head[hash] = pos;
+	}
+
+	return matches;
+}
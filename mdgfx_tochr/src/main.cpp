@@ -1,18 +1,30 @@
 #include <getopt.h>
 
 #include "filesys.hpp"
+#include <algorithm>
 #include <chrgfx/chrgfx.hpp>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <png++/png.hpp>
 #include <string>
 #include <vector>
 
+#include "bankmanifest.hpp"
+#include "codec.hpp"
 #include "common.hpp"
 #include "gfxdef.hpp"
 #include "gfxutils.hpp"
+#include "outcache.hpp"
 #include "project.hpp"
+#include "romlayout.hpp"
+#include "pngstream.hpp"
+#include "tilemerge.hpp"
 #include "tileopt.hpp"
+#include "tilepool.hpp"
+#include "tileview.hpp"
+#include "workpool.hpp"
 
 using namespace std;
 using namespace chrgfx;
@@ -20,15 +32,163 @@ using namespace png;
 
 void process_args(int argc, char ** argv);
 void print_help();
-void process_unoptimized(const buffer<byte_t> & tiles, size_t const bank_size,
-												 size_t const img_width_chr);
 
-void process_optimized(const buffer<byte_t> & tiles, size_t const bank_size,
-											 size_t const img_width_chr);
+// the codec used for an output file, its compressed size and the estimated
+// 68000 cycles to decompress it
+struct CodecChoice
+{
+	Codec codec;
+	size_t size;
+	size_t cycles;
+
+	CodecChoice() : codec(CODEC_NONE), size(0), cycles(0) {}
+};
+
+// a source image and the files generated from it
+struct ImageJob
+{
+	string source_path;
+	string out_prefix;
+
+	// number of banks to process at once and number of threads used to analyze
+	// a whole image (both are 1 when several images are processed at once)
+	size_t jobs;
+	size_t threads;
+
+	// every output file written so far, relative to the output prefix
+	vector<string> output_suffixes;
+
+	// hashes of the tiles from this run and the last, when building
+	// incrementally
+	unique_ptr<BankManifest> manifest;
+	// set once an output has been rewritten, at which point the old manifest is
+	// no longer valid
+	bool outputs_changed;
+
+	// a line for each output compressed with --auto-compress
+	vector<string> codec_report;
+
+	ImageJob(string const & source_path, string const & out_prefix);
+
+	/**
+	 * Opens an output file, named by its suffix to the output prefix
+	 */
+	ofstream open_output(string const & suffix);
+
+	/**
+	 * Writes an output file in one go
+	 * When building incrementally, a file which already has the same contents is
+	 * left untouched so its modification time is kept
+	 */
+	void write_output(string const & suffix, string const & data);
+
+	/**
+	 * Records an output file from a previous run which is still up to date
+	 */
+	void keep_output(string const & suffix);
+
+	/**
+	 * True if the previous run's output files for this image exist and the tiles
+	 * they were made from haven't changed
+	 */
+	bool image_up_to_date(vector<string> const & suffixes) const;
+
+	/**
+	 * As above, for the files of one bank
+	 */
+	bool bank_up_to_date(size_t const bankidx,
+											 vector<string> const & suffixes) const;
+
+	/**
+	 * Notes the codec picked for an output file in the report
+	 */
+	void report_codec(string const & suffix, CodecChoice const & choice);
+};
+
+// thrown when a source image cannot be read
+struct SourceError : public runtime_error
+{
+	SourceError(string const & source_path, string const & reason);
+};
+
+void process_image(ImageJob & job);
+
+void process_unoptimized(ImageJob & job, TileView const & tiles,
+												 size_t const bank_size, size_t const img_width_chr);
+
+void process_optimized(ImageJob & job, TileView const & tiles,
+											 size_t const bank_size, size_t const img_width_chr);
+
+void process_optimized_stream(ImageJob & job, PngTileRowReader & reader,
+															size_t const bank_size);
+
+void process_shared_dict(vector<ImageJob> & jobs);
+
+// encoded output for a single bank, ready to be written
+struct BankOutput
+{
+	string chr;
+	string map;
+	CodecChoice chr_choice;
+	CodecChoice map_choice;
+	// the files from the previous run are still up to date
+	bool unchanged;
+
+	BankOutput() : unchanged(false) {}
+};
+
+string bank_suffix(size_t const bankidx);
+
+// the files written for each bank, relative to the bank suffix
+vector<string> bank_output_suffixes();
+
+void write_bank(ImageJob & job, size_t const bankidx, BankOutput & out);
+
+void write_image_chr(ImageJob & job, string const & chr);
+
+void write_image_map(ImageJob & job, string const & map,
+										 CodecChoice const & choice);
+
+void write_palette(ImageJob & job, palette const & pal);
+
+void write_rom_layout(ImageJob & job);
+
+void write_chrs(ostream & out, TileAnalysis const & analysis);
+
+string compress_chr(string const & chr, size_t const threads = 1,
+										CodecChoice * choice = nullptr);
+
+void write_map(ostream & out, vector<u16> const & tilemap,
+							 CodecChoice * choice = nullptr);
+
+void write_optimized_map(ostream & out, TileAnalysis const & analysis,
+												 size_t const img_width_chr,
+												 CodecChoice * choice = nullptr);
+
+void write_optimized_map(ostream & out, vector<TileOptInfo> const & infolist,
+												 size_t const index, size_t const length,
+												 size_t const img_width_chr,
+												 CodecChoice * choice = nullptr);
+
+BankOutput make_bank_output(TileAnalysis const & analysis,
+														size_t const img_width_chr);
+
+void write_shared_banks(ImageJob & job, TileAnalysis const & analysis,
+												size_t const bank_size, size_t const img_width_chr);
+
+TileAnalysis merge_tiles(TileAnalysis analysis);
+
+// codecs that can be used for each kind of output, all of which are tried
+// with --auto-compress
+vector<Codec> const CHR_CODECS { CODEC_NONE, CODEC_NEMESIS, CODEC_KOSINSKI,
+																 CODEC_COMPER };
+vector<Codec> const MAP_CODECS { CODEC_NONE, CODEC_ENIGMA, CODEC_KOSINSKI,
+																 CODEC_COMPER };
 
 struct RuntimeConfig
 {
-	string in_image_path;
+	// more than one source indicates batch mode
+	vector<string> in_image_paths;
 	string out_prefix;
 
 	// any value besides 0 indicates banked mode
@@ -47,15 +207,64 @@ struct RuntimeConfig
 	bool make_tilemaps;
 	bool width_header;
 	bool chirari_rle;
+	// decode the image one row of tiles at a time (optimized mode only)
+	bool stream;
+	// dedupe all sources against one set of tiles, written to out_prefix.chr
+	bool shared_dict;
+	// if set, banks share a set of resident tiles, which together with each
+	// bank's own tiles fits in this many tiles of VRAM
+	size_t vram_budget;
+	// if set, banks are animation frames which are loaded into this many VRAM
+	// slots, with a list of only the tiles to upload for each frame
+	size_t delta_slots;
+
+	// pack all the chr output into one block that is safe to DMA from, which
+	// will be placed at rom_base
+	bool rom_layout;
+	size_t rom_base;
+
+	// number of banks (or images, in batch mode) to process at once
+	size_t jobs;
+	// number of threads used to analyze a whole (non-banked) image
+	size_t threads;
+
+	// if set, outputs are kept here and reused when the source is unchanged
+	string cache_dir;
+
+	// compression for every chr written
+	Codec chr_codec;
+	// compression for every tilemap written
+	Codec map_codec;
+	// pick the codec for each output that gives the lowest size * byte_cost +
+	// decompression cycles
+	bool auto_compress;
+	size_t byte_cost;
+
+	// merge tiles that are nearly the same until there are no more than this
+	// many in each image or bank...
+	size_t max_tiles;
+	// ...or as many as possible that differ by no more than this many pixels
+	optional<size_t> tolerance;
+
+	// only rebuild the banks whose tiles have changed since the last run, and
+	// leave any output that comes out the same untouched
+	bool incremental;
 
 	RuntimeConfig() :
 			rows_per_bank(0), tile_base(0), pal_line(PAL0), tile_priority(false),
-			make_palette(false), optimize(false), make_tilemaps(false),
-			chr_by_bank(false), width_header(false), chirari_rle(false)
+			make_palette(false), optimize(false), chr_by_bank(false),
+			make_tilemaps(false), width_header(false), chirari_rle(false),
+			stream(false), shared_dict(false), vram_budget(0),
+			delta_slots(0), rom_layout(false), rom_base(0), jobs(1), threads(1),
+			chr_codec(CODEC_NONE), map_codec(CODEC_NONE), auto_compress(false),
+			byte_cost(200), max_tiles(0), tolerance(nullopt), incremental(false)
 	{
 	}
 } cfg;
 
+string cache_settings();
+void cache_outputs(ImageJob const & job, OutputCache const & cache);
+
 int main(int argc, char ** argv)
 {
 	try
@@ -63,29 +272,268 @@ int main(int argc, char ** argv)
 		process_args(argc, argv);
 
 		// validity checks
-		if(cfg.in_image_path.empty())
+		if(cfg.in_image_paths.empty())
 		{
 			cerr << "No source image specified" << endl;
 			exit(9);
 		}
 
-		if(cfg.out_prefix.empty())
+		if(cfg.stream && !cfg.optimize)
+		{
+			cerr << "Streaming is only supported with --optimize" << endl;
+			exit(15);
+		}
+
+		if((cfg.max_tiles > 0 || cfg.tolerance.has_value()) && !cfg.optimize)
+		{
+			cerr << "Tile merging is only supported with --optimize" << endl;
+			exit(34);
+		}
+
+		if(cfg.vram_budget > 0 &&
+			 (!cfg.optimize || cfg.rows_per_bank == 0 || !cfg.chr_by_bank))
+		{
+			cerr << "VRAM budget requires --optimize, --rows-per-bank and "
+							"--chr-by-bank"
+					 << endl;
+			exit(22);
+		}
+
+		if(cfg.delta_slots > 0 &&
+			 (!cfg.optimize || cfg.rows_per_bank == 0 || !cfg.make_tilemaps ||
+				cfg.chr_by_bank || cfg.vram_budget > 0))
+		{
+			cerr << "Delta uploads require --optimize, --rows-per-bank and "
+							"--make-tilemap, and cannot be used with --chr-by-bank or "
+							"--vram-budget"
+					 << endl;
+			exit(24);
+		}
+
+		if(cfg.incremental &&
+			 (cfg.stream || cfg.shared_dict || cfg.vram_budget > 0 ||
+				cfg.delta_slots > 0))
 		{
-			cfg.out_prefix = strip_extension(cfg.in_image_path);
+			cerr << "Incremental builds cannot be used with --stream, --shared-dict, "
+							"--vram-budget or --delta-slots"
+					 << endl;
+			exit(26);
 		}
 
-		image<index_pixel> input_image;
-		try
+		if((cfg.map_codec != CODEC_NONE || cfg.auto_compress) && cfg.chirari_rle)
 		{
-			input_image.read(cfg.in_image_path);
+			cerr << "Tilemap compression cannot be used with --chirari-rle" << endl;
+			exit(28);
+		}
+
+		if(cfg.auto_compress &&
+			 (cfg.chr_codec != CODEC_NONE || cfg.map_codec != CODEC_NONE ||
+				cfg.incremental || cfg.shared_dict || cfg.vram_budget > 0 ||
+				cfg.delta_slots > 0))
+		{
+			cerr << "Automatic compression cannot be used with --compress, "
+							"--map-compress, --incremental, --shared-dict, --vram-budget or "
+							"--delta-slots"
+					 << endl;
+			exit(30);
+		}
+
+		if(cfg.shared_dict)
+		{
+			if(!cfg.optimize || cfg.chr_by_bank || !cfg.cache_dir.empty() ||
+				 cfg.rom_layout)
+			{
+				cerr << "Shared tile dictionary requires --optimize and cannot be "
+								"used with --chr-by-bank, --cache or --rom-layout"
+						 << endl;
+				exit(20);
+			}
+
+			if(cfg.out_prefix.empty())
+			{
+				cerr << "Shared tile dictionary requires an output prefix" << endl;
+				exit(19);
+			}
 		}
-		catch(const exception & e)
+		else if(cfg.in_image_paths.size() > 1 && !cfg.out_prefix.empty())
 		{
-			cerr << "Failed to read source image " << cfg.in_image_path << endl;
-			cerr << e.what() << endl;
-			exit(3);
+			cerr << "Output prefix cannot be used with multiple sources" << endl;
+			exit(19);
 		}
 
+		// outputs for each image are named after the image, unless there is only
+		// the one image and a prefix was given (with a shared dictionary, the
+		// prefix is used for the dictionary instead)
+		bool const by_source { cfg.shared_dict || cfg.out_prefix.empty() };
+		vector<ImageJob> jobs;
+		for(auto const & source_path : cfg.in_image_paths)
+			jobs.emplace_back(source_path, by_source ? strip_extension(source_path)
+																							 : cfg.out_prefix);
+
+		if(cfg.shared_dict)
+			process_shared_dict(jobs);
+		else if(jobs.size() == 1)
+			process_image(jobs.front());
+		else
+			// the workers are spread across the images rather than within them
+			parallel_for(jobs.size(), cfg.jobs, [&](size_t this_job) {
+				auto & job { jobs[this_job] };
+				job.jobs = 1;
+				job.threads = 1;
+				process_image(job);
+			});
+	}
+	catch(SourceError const & e)
+	{
+		cerr << e.what() << endl;
+		return 3;
+	}
+	catch(exception const & e)
+	{
+		cerr << "Fatal Error: " << e.what() << endl;
+		return -1;
+	}
+	return 0;
+}
+
+ImageJob::ImageJob(string const & source_path, string const & out_prefix) :
+		source_path(source_path), out_prefix(out_prefix), jobs(cfg.jobs),
+		threads(cfg.threads), outputs_changed(false)
+{
+}
+
+ofstream ImageJob::open_output(string const & suffix)
+{
+	string const path { out_prefix + suffix };
+	// replace rather than truncate any existing file, since it may be hard
+	// linked from the cache
+	remove(path.c_str());
+	output_suffixes.push_back(suffix);
+	return ofstream_checked(path);
+}
+
+void ImageJob::write_output(string const & suffix, string const & data)
+{
+	if(manifest)
+	{
+		ifstream existing { out_prefix + suffix, ios::binary };
+		if(existing.good())
+		{
+			string const existing_data { istreambuf_iterator<char>(existing),
+																	 istreambuf_iterator<char>() };
+			if(existing_data == data)
+			{
+				keep_output(suffix);
+				return;
+			}
+		}
+
+		// remove the old manifest before changing anything it describes, so an
+		// interrupted run can't leave it vouching for files it didn't write
+		if(!outputs_changed)
+		{
+			remove((out_prefix + ".banks").c_str());
+			outputs_changed = true;
+		}
+	}
+
+	auto out { open_output(suffix) };
+	out.write(data.data(), data.size());
+}
+
+void ImageJob::keep_output(string const & suffix)
+{
+	output_suffixes.push_back(suffix);
+}
+
+bool ImageJob::image_up_to_date(vector<string> const & suffixes) const
+{
+	if(!manifest || !manifest->image_unchanged())
+		return false;
+	for(auto const & suffix : suffixes)
+		if(!filesystem::exists(out_prefix + suffix))
+			return false;
+	return true;
+}
+
+void ImageJob::report_codec(string const & suffix, CodecChoice const & choice)
+{
+	codec_report.push_back(suffix + ' ' + codec_name(choice.codec) + ' ' +
+												 to_string(choice.size) + ' ' +
+												 to_string(choice.cycles));
+}
+
+bool ImageJob::bank_up_to_date(size_t const bankidx,
+															 vector<string> const & suffixes) const
+{
+	if(!manifest || !manifest->bank_unchanged(bankidx))
+		return false;
+	// (this runs on the worker threads, so it can't use the exists() helper,
+	// which stats into a shared static buffer)
+	for(auto const & suffix : suffixes)
+		if(!filesystem::exists(out_prefix + bank_suffix(bankidx) + suffix))
+			return false;
+	return true;
+}
+
+SourceError::SourceError(string const & source_path, string const & reason) :
+		runtime_error("Failed to read source image " + source_path + "\n" + reason)
+{
+}
+
+image<index_pixel> read_image(ImageJob const & job)
+{
+	image<index_pixel> input_image;
+	try
+	{
+		input_image.read(job.source_path);
+	}
+	catch(const exception & e)
+	{
+		throw SourceError(job.source_path, e.what());
+	}
+	return input_image;
+}
+
+unique_ptr<PngTileRowReader> open_image_stream(ImageJob const & job)
+{
+	try
+	{
+		return unique_ptr<PngTileRowReader>(
+				new PngTileRowReader(job.source_path));
+	}
+	catch(const exception & e)
+	{
+		throw SourceError(job.source_path, e.what());
+	}
+}
+
+void process_image(ImageJob & job)
+{
+	// nothing to do if this image has been processed with the same settings
+	unique_ptr<OutputCache> cache;
+	if(!cfg.cache_dir.empty())
+	{
+		cache.reset(
+				new OutputCache(cfg.cache_dir, job.source_path, cache_settings()));
+		if(cache->restore(job.out_prefix))
+			return;
+	}
+
+	if(cfg.stream)
+	{
+		auto reader { open_image_stream(job) };
+
+		process_optimized_stream(job, *reader,
+														 reader->width_chr() * cfg.rows_per_bank);
+
+		if(cfg.make_palette)
+			write_palette(job, reader->palette());
+	}
+	else
+	{
+		auto input_image { read_image(job) };
+
 		size_t tiles_per_bank = 0;
 		size_t const
 				// number of tiles per row in input image
@@ -99,36 +547,63 @@ int main(int argc, char ** argv)
 				// number of tiles per bank
 				bank_size { img_width_chr * cfg.rows_per_bank };
 
-		buffer<byte_t> input_basic_tiles { png_chunk(
-				MD_CHR.width(), MD_CHR.height(), input_image.get_pixbuf()) };
+		// tiles are read in place from the decoded image; only those that make it
+		// to the output are copied out
+		TileView input_tiles { input_image.get_pixbuf() };
+
+		// the maps also depend on the image width, so a change there rebuilds
+		// everything along with the other settings
+		if(cfg.incremental)
+		{
+			job.manifest.reset(new BankManifest(
+					job.out_prefix + ".banks",
+					cache_settings() + "width " + to_string(img_width_chr) + '\n'));
+			job.manifest->update(input_tiles, bank_size);
+		}
 
 		if(cfg.optimize)
-			process_optimized(input_basic_tiles, bank_size, img_width_chr);
+			process_optimized(job, input_tiles, bank_size, img_width_chr);
 		else
-			process_unoptimized(input_basic_tiles, bank_size, img_width_chr);
+			process_unoptimized(job, input_tiles, bank_size, img_width_chr);
 
 		if(cfg.make_palette)
-		{
-			uptr<byte_t> out_pal { encode_pal(MD_PAL, MD_COL,
-																				input_image.get_palette()) };
-			string palette_out_path { cfg.out_prefix };
-			palette_out_path.append(".pal");
-			auto palette_out { ofstream_checked(palette_out_path) };
-			// only copy one subpalette's worth of colors
-			palette_out.write((char *)out_pal.get(), MD_PAL.datasize() / 8);
-			palette_out.close();
-		}
+			write_palette(job, input_image.get_palette());
 	}
-	catch(exception const & e)
+
+	if(cfg.rom_layout)
+		write_rom_layout(job);
+
+	// one line per compressed output: the file suffix, the codec picked, its
+	// size in bytes and the estimated cycles to decompress it
+	if(cfg.auto_compress)
 	{
-		cerr << "Fatal Error: " << e.what() << endl;
-		return -1;
+		string report;
+		for(auto const & line : job.codec_report)
+			report += line + '\n';
+		job.write_output(".codecs", report);
 	}
-	return 0;
+
+	if(job.manifest)
+	{
+		// anything the last run wrote that this one didn't (such as banks past
+		// the new last bank) is out of date, and would otherwise be left behind
+		auto const & written { job.output_suffixes };
+		for(auto const & suffix : job.manifest->previous_outputs())
+			if(suffix != ".banks" &&
+				 find(written.begin(), written.end(), suffix) == written.end())
+				remove((job.out_prefix + suffix).c_str());
+
+		// written last, so it only describes outputs which were written in full
+		job.manifest->set_outputs(written);
+		job.write_output(".banks", job.manifest->str());
+	}
+
+	if(cache)
+		cache_outputs(job, *cache);
 }
 
-void process_unoptimized(buffer<byte_t> const & tiles, size_t const bank_size,
-												 size_t const img_width_chr)
+void process_unoptimized(ImageJob & job, TileView const & tiles,
+												 size_t const bank_size, size_t const img_width_chr)
 {
 	// TODO does this imply we can output by bank only if tilemaps are also
 	// generated?
@@ -138,129 +613,631 @@ void process_unoptimized(buffer<byte_t> const & tiles, size_t const bank_size,
 
 	if(!by_bank || (by_bank && !cfg.chr_by_bank))
 	{
-		string tiles_out_path { cfg.out_prefix };
-		tiles_out_path.append(".chr");
-		auto tiles_out { ofstream_checked(tiles_out_path) };
+		ostringstream tiles_out;
 		dump_md_tiles(tiles, tiles_out);
+		write_image_chr(job, tiles_out.str());
 	}
 
 	if(!by_bank && cfg.make_tilemaps)
 	{
-		string map_out_path { cfg.out_prefix };
-		map_out_path.append(".map");
-		auto map_out { ofstream_checked(map_out_path) };
+		ostringstream map_out;
 		auto tilemap { make_simple_tilemap(0, tiles.size(), cfg.pal_line,
 																			 cfg.tile_priority, cfg.tile_base) };
 		if(cfg.width_header)
 			tilemap.emplace(tilemap.begin(), img_width_chr);
-		dump_md_tilemap(tilemap, map_out);
+		CodecChoice choice;
+		write_map(map_out, tilemap, &choice);
+		write_image_map(job, map_out.str(), choice);
 	}
 
 	if(by_bank)
 	{
 		size_t bank_count = tiles.size() / bank_size;
-		for(auto bankidx { 0 }; bankidx < bank_count; ++bankidx)
-		{
-			stringstream ss;
-			ss << cfg.out_prefix << '.' << setw(3) << setfill('0') << bankidx;
+		parallel_ordered<BankOutput>(
+				bank_count, job.jobs,
+				[&](size_t bankidx) {
+					BankOutput out;
 
-			if(cfg.chr_by_bank)
-			{
-				string path = ss.str() + ".chr";
-				auto tiles_out { ofstream_checked(path) };
-				dump_md_tiles(tiles, tiles_out, bank_size * bankidx, bank_size);
-			}
+					if(job.bank_up_to_date(bankidx, bank_output_suffixes()))
+					{
+						out.unchanged = true;
+						return out;
+					}
 
-			if(cfg.make_tilemaps)
-			{
-				string path = ss.str() + ".map";
-				auto map_out { ofstream_checked(path) };
-				auto tilemap { make_simple_tilemap(bank_size * bankidx, bank_size,
-																					 cfg.pal_line, cfg.tile_priority,
-																					 cfg.tile_base) };
-				if(cfg.width_header)
-					tilemap.emplace(tilemap.begin(), img_width_chr);
-				dump_md_tilemap(tilemap, map_out);
-			}
-		}
+					if(cfg.chr_by_bank)
+					{
+						ostringstream tiles_out;
+						dump_md_tiles(tiles, tiles_out, bank_size * bankidx, bank_size);
+						out.chr = compress_chr(tiles_out.str(), 1, &out.chr_choice);
+					}
+
+					if(cfg.make_tilemaps)
+					{
+						ostringstream map_out;
+						auto tilemap { make_simple_tilemap(bank_size * bankidx, bank_size,
+																							 cfg.pal_line, cfg.tile_priority,
+																							 cfg.tile_base) };
+						if(cfg.width_header)
+							tilemap.emplace(tilemap.begin(), img_width_chr);
+						write_map(map_out, tilemap, &out.map_choice);
+						out.map = map_out.str();
+					}
+
+					return out;
+				},
+				[&](size_t bankidx, BankOutput & out) { write_bank(job, bankidx, out); });
 	}
 }
 
-void process_optimized(buffer<byte_t> const & basic_tiles,
+void process_optimized(ImageJob & job, TileView const & tiles,
 											 size_t const bank_size, size_t const img_width_chr)
 {
 	// bank_size = number of tiles in a bank
 	bool by_bank { bank_size > 0 && (cfg.make_tilemaps || cfg.chr_by_bank) };
 
-	if(!by_bank || (by_bank && !cfg.chr_by_bank))
+	if(by_bank && (cfg.vram_budget > 0 || cfg.delta_slots > 0))
 	{
-		auto infolist { analyze(basic_tiles, 0,
-														basic_tiles.size<byte_t[BASIC_CHR_BYTESZ]>()) };
-		string tiles_out_path { cfg.out_prefix };
-		tiles_out_path.append(".chr");
-		auto tiles_out { ofstream_checked(tiles_out_path) };
-		auto filtered { filter_chrs(infolist) };
-		dump_md_tiles(filtered, tiles_out);
+		// all banks are analyzed together, so they can share tiles
+		size_t bank_count = tiles.size() / bank_size;
+		write_shared_banks(job,
+											 merge_tiles(analyze(tiles, 0, bank_size * bank_count,
+																					 job.threads)),
+											 bank_size, img_width_chr);
+		return;
 	}
 
-	if(!by_bank && cfg.make_tilemaps)
+	if(!by_bank || (by_bank && !cfg.chr_by_bank))
 	{
-		auto infolist { analyze(basic_tiles, 0,
-														basic_tiles.size<byte_t[BASIC_CHR_BYTESZ]>()) };
-		string map_out_path { cfg.out_prefix };
-		map_out_path.append(".map");
-		auto map_out { ofstream_checked(map_out_path) };
+		vector<string> image_suffixes { ".chr" };
+		if(!by_bank && cfg.make_tilemaps)
+			image_suffixes.push_back(".map");
 
-		vector<u16> tilemap;
-		if(cfg.chirari_rle)
-			tilemap = make_rle_tilemap(infolist, 0, infolist.size(), img_width_chr,
-																 cfg.tile_base);
+		if(job.image_up_to_date(image_suffixes))
+		{
+			for(auto const & suffix : image_suffixes)
+				job.keep_output(suffix);
+		}
 		else
 		{
-			tilemap = make_optinfo_tilemap(infolist, 0, infolist.size(), cfg.pal_line,
-																		 cfg.tile_priority, cfg.tile_base);
-			if(cfg.width_header)
-				tilemap.emplace(tilemap.begin(), img_width_chr);
+			// analyze once, use the result for both the chr and the map
+			auto analysis { merge_tiles(
+					analyze(tiles, 0, tiles.size(), job.threads)) };
+
+			ostringstream tiles_out;
+			write_chrs(tiles_out, analysis);
+			write_image_chr(job, tiles_out.str());
+
+			if(!by_bank && cfg.make_tilemaps)
+			{
+				ostringstream map_out;
+				CodecChoice choice;
+				write_optimized_map(map_out, analysis, img_width_chr, &choice);
+				write_image_map(job, map_out.str(), choice);
+			}
 		}
-		dump_md_tilemap(tilemap, map_out);
 	}
 
 	if(by_bank)
 	{
-		size_t bank_count =
-				(basic_tiles.size<byte_t[BASIC_CHR_BYTESZ]>()) / bank_size;
-		for(auto bankidx { 0 }; bankidx < bank_count; ++bankidx)
-		{
-			auto infolist { analyze(basic_tiles, bank_size * bankidx, bank_size) };
-			stringstream ss;
-			ss << cfg.out_prefix << '.' << setw(3) << setfill('0') << bankidx;
+		size_t bank_count = tiles.size() / bank_size;
+		parallel_ordered<BankOutput>(
+				bank_count, job.jobs,
+				[&](size_t bankidx) {
+					// banks whose tiles haven't changed aren't analyzed again
+					if(job.bank_up_to_date(bankidx, bank_output_suffixes()))
+					{
+						BankOutput out;
+						out.unchanged = true;
+						return out;
+					}
+					return make_bank_output(
+							merge_tiles(analyze(tiles, bank_size * bankidx, bank_size)),
+							img_width_chr);
+				},
+				[&](size_t bankidx, BankOutput & out) { write_bank(job, bankidx, out); });
+	}
+}
 
-			if(cfg.chr_by_bank)
-			{
-				string path = ss.str() + ".chr";
-				auto tiles_out { ofstream_checked(path) };
-				dump_md_tiles(filter_chrs(infolist), tiles_out);
-			}
+void process_shared_dict(vector<ImageJob> & jobs)
+{
+	// each image is analyzed on its own, then they are all merged into one
+	// dictionary in the order they were given, so the shared tiles come out the
+	// same no matter which image happened to finish first
+	vector<TileAnalyzer> analyzers(jobs.size());
+	vector<size_t> widths_chr(jobs.size());
+	size_t const image_threads { jobs.size() > 1 ? 1 : cfg.threads };
+
+	parallel_for(jobs.size(), cfg.jobs, [&](size_t this_job) {
+		auto & job { jobs[this_job] };
+		auto & analyzer { analyzers[this_job] };
 
-			if(cfg.make_tilemaps)
+		if(cfg.stream)
+		{
+			auto reader { open_image_stream(job) };
+			widths_chr[this_job] = reader->width_chr();
+			while(reader->next_row())
 			{
-				string path = ss.str() + ".map";
-				auto map_out { ofstream_checked(path) };
-				vector<u16> tilemap;
-				if(cfg.chirari_rle)
-					tilemap = make_rle_tilemap(infolist, bank_size * bankidx, bank_size,
-																		 img_width_chr, cfg.tile_base);
-				else
-				{
-					tilemap = make_optinfo_tilemap(infolist, 0, bank_size, cfg.pal_line,
-																				 cfg.tile_priority, cfg.tile_base);
-					if(cfg.width_header)
-						tilemap.emplace(tilemap.begin(), img_width_chr);
-				}
-				dump_md_tilemap(tilemap, map_out);
+				TileView row_tiles { reader->tiles() };
+				for(size_t this_chr { 0 }; this_chr < row_tiles.size(); ++this_chr)
+					analyzer.add(row_tiles.get_packed(this_chr));
 			}
+
+			if(cfg.make_palette)
+				write_palette(job, reader->palette());
 		}
+		else
+		{
+			auto input_image { read_image(job) };
+			TileView input_tiles { input_image.get_pixbuf() };
+			widths_chr[this_job] = input_tiles.width();
+			analyzer = make_analyzer(input_tiles, 0, input_tiles.size(), image_threads);
+
+			if(cfg.make_palette)
+				write_palette(job, input_image.get_palette());
+		}
+	});
+
+	TileAnalyzer dict;
+	// index of each image's first tile within the dictionary
+	vector<size_t> offsets(jobs.size() + 1);
+	for(size_t this_job { 0 }; this_job < jobs.size(); ++this_job)
+	{
+		offsets[this_job] = dict.size();
+		dict.merge(analyzers[this_job]);
+		analyzers[this_job] = TileAnalyzer();
 	}
+	offsets.back() = dict.size();
+	dict.finish();
+	auto analysis { merge_tiles(dict.result()) };
+
+	ostringstream dict_chrs;
+	write_chrs(dict_chrs, analysis);
+	string const dict_chr { compress_chr(dict_chrs.str(), cfg.threads) };
+
+	string const dict_path { cfg.out_prefix + ".chr" };
+	remove(dict_path.c_str());
+	auto dict_out { ofstream_checked(dict_path) };
+	dict_out.write(dict_chr.data(), dict_chr.size());
+
+	if(!cfg.make_tilemaps)
+		return;
+
+	// each image's map (or maps, in banked mode) points into the shared tiles
+	parallel_for(jobs.size(), cfg.jobs, [&](size_t this_job) {
+		auto & job { jobs[this_job] };
+		size_t const img_width_chr { widths_chr[this_job] },
+				image_size { offsets[this_job + 1] - offsets[this_job] },
+				bank_size { img_width_chr * cfg.rows_per_bank };
+
+		if(bank_size == 0)
+		{
+			auto map_out { job.open_output(".map") };
+			write_optimized_map(map_out, analysis.infolist, offsets[this_job],
+													image_size, img_width_chr);
+			return;
+		}
+
+		for(size_t bankidx { 0 }; bankidx < image_size / bank_size; ++bankidx)
+		{
+			auto map_out { job.open_output(bank_suffix(bankidx) + ".map") };
+			write_optimized_map(map_out, analysis.infolist,
+													offsets[this_job] + bank_size * bankidx, bank_size,
+													img_width_chr);
+		}
+	});
+}
+
+string bank_suffix(size_t const bankidx)
+{
+	stringstream ss;
+	ss << '.' << setw(3) << setfill('0') << bankidx;
+	return ss.str();
+}
+
+vector<string> bank_output_suffixes()
+{
+	vector<string> suffixes;
+	if(cfg.chr_by_bank)
+		suffixes.push_back(".chr");
+	if(cfg.make_tilemaps)
+		suffixes.push_back(".map");
+	return suffixes;
+}
+
+void write_bank(ImageJob & job, size_t const bankidx, BankOutput & out)
+{
+	string suffix { bank_suffix(bankidx) };
+
+	if(out.unchanged)
+	{
+		for(auto const & file_suffix : bank_output_suffixes())
+			job.keep_output(suffix + file_suffix);
+		return;
+	}
+
+	if(cfg.chr_by_bank)
+	{
+		job.write_output(suffix + ".chr", out.chr);
+		if(cfg.auto_compress)
+			job.report_codec(suffix + ".chr", out.chr_choice);
+	}
+
+	if(cfg.make_tilemaps)
+	{
+		job.write_output(suffix + ".map", out.map);
+		if(cfg.auto_compress)
+			job.report_codec(suffix + ".map", out.map_choice);
+	}
+}
+
+// the chr and map for a whole image
+void write_image_chr(ImageJob & job, string const & chr)
+{
+	CodecChoice choice;
+	job.write_output(".chr", compress_chr(chr, job.threads, &choice));
+	if(cfg.auto_compress)
+		job.report_codec(".chr", choice);
+}
+
+void write_image_map(ImageJob & job, string const & map,
+										 CodecChoice const & choice)
+{
+	job.write_output(".map", map);
+	if(cfg.auto_compress)
+		job.report_codec(".map", choice);
+}
+
+void write_palette(ImageJob & job, palette const & pal)
+{
+	ostringstream palette_out;
+	dump_md_palette(pal, palette_out);
+	job.write_output(".pal", palette_out.str());
+}
+
+void write_rom_layout(ImageJob & job)
+{
+	// every chr that was written for this image is a block to be placed
+	vector<string> blocks;
+	vector<size_t> block_sizes;
+	for(auto const & suffix : job.output_suffixes)
+	{
+		if(suffix.size() < 4 || suffix.compare(suffix.size() - 4, 4, ".chr") != 0)
+			continue;
+		auto block_in { ifstream_checked(job.out_prefix + suffix) };
+		blocks.emplace_back(istreambuf_iterator<char>(block_in),
+												istreambuf_iterator<char>());
+		block_sizes.push_back(blocks.back().size());
+	}
+
+	auto layout { plan_rom_layout(block_sizes, cfg.rom_base) };
+
+	// padding between blocks is zeroed
+	string packed(layout.size, '\0');
+	for(size_t this_block { 0 }; this_block < blocks.size(); ++this_block)
+		copy(blocks[this_block].begin(), blocks[this_block].end(),
+				 packed.begin() + layout.offsets[this_block]);
+
+	job.write_output(".chrpack", packed);
+
+	// offsets table: for each chr, in the order they were written, the ROM
+	// address (including the base) and the size in bytes, as big endian longs
+	string table;
+	auto push_long = [&table](u32 value) {
+		for(int shift { 24 }; shift >= 0; shift -= 8)
+			table.push_back((char)(value >> shift));
+	};
+	for(size_t this_block { 0 }; this_block < blocks.size(); ++this_block)
+	{
+		push_long(cfg.rom_base + layout.offsets[this_block]);
+		push_long(block_sizes[this_block]);
+	}
+
+	job.write_output(".chrofs", table);
+}
+
+// describes every setting that affects the contents of the output files
+string cache_settings()
+{
+	stringstream ss;
+	ss << PROJECT::VERSION << '\n'
+		 << "optimize " << cfg.optimize << '\n'
+		 << "rows_per_bank " << cfg.rows_per_bank << '\n'
+		 << "tile_base " << cfg.tile_base << '\n'
+		 << "pal_line " << cfg.pal_line << '\n'
+		 << "tile_priority " << cfg.tile_priority << '\n'
+		 << "chirari_rle " << cfg.chirari_rle << '\n'
+		 << "make_palette " << cfg.make_palette << '\n'
+		 << "make_tilemaps " << cfg.make_tilemaps << '\n'
+		 << "chr_by_bank " << cfg.chr_by_bank << '\n'
+		 << "width_header " << cfg.width_header << '\n'
+		 << "vram_budget " << cfg.vram_budget << '\n'
+		 << "delta_slots " << cfg.delta_slots << '\n'
+		 << "rom_layout " << cfg.rom_layout << '\n'
+		 << "rom_base " << cfg.rom_base << '\n'
+		 << "chr_codec " << cfg.chr_codec << '\n'
+		 << "map_codec " << cfg.map_codec << '\n'
+		 << "auto_compress " << cfg.auto_compress << '\n'
+		 << "byte_cost " << cfg.byte_cost << '\n'
+		 << "max_tiles " << cfg.max_tiles << '\n'
+		 << "tolerance " << cfg.tolerance.value_or(PIXELS_PER_TILE + 1) << '\n';
+	return ss.str();
+}
+
+void cache_outputs(ImageJob const & job, OutputCache const & cache)
+{
+	// the outputs have already been written, so failing to cache them is only
+	// worth a warning
+	try
+	{
+		cache.store(job.out_prefix, job.output_suffixes);
+	}
+	catch(exception const & e)
+	{
+		cerr << "Warning: could not store outputs in cache: " << e.what() << endl;
+	}
+}
+
+void write_chrs(ostream & out, TileAnalysis const & analysis)
+{
+	dump_md_tiles(analysis.chrs, out);
+}
+
+// compresses with the configured codec, or the best one with --auto-compress
+string compress_output(string const & data, Codec const codec,
+											 vector<Codec> const & auto_codecs, size_t const threads,
+											 CodecChoice * choice)
+{
+	if(codec == CODEC_NONE && !cfg.auto_compress)
+		return data;
+
+	Packed packed { cfg.auto_compress
+											? pack_best(auto_codecs, data, cfg.byte_cost, threads)
+											: pack(codec, data, threads) };
+	if(choice != nullptr)
+	{
+		choice->codec = packed.codec;
+		choice->size = packed.data.size();
+		choice->cycles = packed.cycles;
+	}
+	return move(packed.data);
+}
+
+string compress_chr(string const & chr, size_t const threads,
+										CodecChoice * choice)
+{
+	return compress_output(chr, cfg.chr_codec, CHR_CODECS, threads, choice);
+}
+
+void write_map(ostream & out, vector<u16> const & tilemap,
+							 CodecChoice * choice)
+{
+	if(cfg.map_codec == CODEC_NONE && !cfg.auto_compress)
+	{
+		dump_md_tilemap(tilemap, out);
+		return;
+	}
+
+	ostringstream map_out;
+	dump_md_tilemap(tilemap, map_out);
+	out << compress_output(map_out.str(), cfg.map_codec, MAP_CODECS, 1, choice);
+}
+
+// the infolist of an analysis covers exactly one image or bank, so the whole
+// list is used for the map
+void write_optimized_map(ostream & out, TileAnalysis const & analysis,
+												 size_t const img_width_chr, CodecChoice * choice)
+{
+	write_optimized_map(out, analysis.infolist, 0, analysis.infolist.size(),
+											img_width_chr, choice);
+}
+
+void write_optimized_map(ostream & out, vector<TileOptInfo> const & infolist,
+												 size_t const index, size_t const length,
+												 size_t const img_width_chr, CodecChoice * choice)
+{
+	vector<u16> tilemap;
+	if(cfg.chirari_rle)
+		tilemap =
+				make_rle_tilemap(infolist, index, length, img_width_chr, cfg.tile_base);
+	else
+	{
+		tilemap = make_optinfo_tilemap(infolist, index, length, cfg.pal_line,
+																	 cfg.tile_priority, cfg.tile_base);
+		if(cfg.width_header)
+			tilemap.emplace(tilemap.begin(), img_width_chr);
+	}
+	write_map(out, tilemap, choice);
+}
+
+BankOutput make_bank_output(TileAnalysis const & analysis,
+														size_t const img_width_chr)
+{
+	BankOutput out;
+
+	if(cfg.chr_by_bank)
+	{
+		ostringstream tiles_out;
+		write_chrs(tiles_out, analysis);
+		out.chr = compress_chr(tiles_out.str(), 1, &out.chr_choice);
+	}
+
+	if(cfg.make_tilemaps)
+	{
+		ostringstream map_out;
+		write_optimized_map(map_out, analysis, img_width_chr, &out.map_choice);
+		out.map = map_out.str();
+	}
+
+	return out;
+}
+
+void write_frame_deltas(ImageJob & job, TileAnalysis const & analysis,
+												size_t const bank_size, size_t const img_width_chr)
+{
+	auto deltas { make_frame_deltas(analysis, bank_size, cfg.delta_slots) };
+
+	// the main chr holds every tile that gets uploaded
+	ostringstream tiles_out;
+	dump_md_tiles(deltas.chrs, tiles_out);
+	job.write_output(".chr", compress_chr(tiles_out.str(), job.threads));
+
+	for(size_t frameidx { 0 }; frameidx < deltas.uploads.size(); ++frameidx)
+	{
+		string const suffix { bank_suffix(frameidx) };
+
+		auto map_out { job.open_output(suffix + ".map") };
+		write_optimized_map(map_out, deltas.frame_infolists[frameidx], 0,
+												bank_size, img_width_chr);
+
+		// upload list format, all big endian words:
+		// number of uploads, then for each one, the VRAM tile index to copy to
+		// (including the tile base) and the index of the tile in the main chr
+		auto const & uploads { deltas.uploads[frameidx] };
+		vector<u16> upload_list;
+		upload_list.reserve(1 + uploads.size() * 2);
+		upload_list.push_back(uploads.size());
+		for(auto const & upload : uploads)
+		{
+			size_t const vram_idx { cfg.tile_base + upload.slot };
+			if(vram_idx > 0xffff || upload.chr > 0xffff)
+				throw runtime_error("Frame " + to_string(frameidx) +
+														" uploads tile " + to_string(upload.chr) +
+														" to VRAM index " + to_string(vram_idx) +
+														", which can't be stored in the upload list");
+			upload_list.push_back(vram_idx);
+			upload_list.push_back(upload.chr);
+		}
+		auto upload_out { job.open_output(suffix + ".upl") };
+		dump_md_tilemap(upload_list, upload_out);
+	}
+}
+
+void write_tile_pool(ImageJob & job, TileAnalysis const & analysis,
+										 size_t const bank_size, size_t const img_width_chr)
+{
+	auto pool { make_tile_pool(analysis, bank_size, cfg.vram_budget) };
+
+	// the resident tiles go in the main chr, with the rest of each bank's
+	// tiles in the bank chrs
+	ostringstream tiles_out;
+	dump_md_tiles(pool.resident, tiles_out);
+	job.write_output(".chr", compress_chr(tiles_out.str(), job.threads));
+
+	for(size_t bankidx { 0 }; bankidx < pool.bank_chrs.size(); ++bankidx)
+	{
+		BankOutput out;
+
+		ostringstream bank_tiles_out;
+		dump_md_tiles(pool.bank_chrs[bankidx], bank_tiles_out);
+		out.chr = compress_chr(bank_tiles_out.str(), job.threads);
+
+		if(cfg.make_tilemaps)
+		{
+			ostringstream map_out;
+			write_optimized_map(map_out, pool.bank_infolists[bankidx], 0, bank_size,
+													img_width_chr);
+			out.map = map_out.str();
+		}
+
+		write_bank(job, bankidx, out);
+	}
+}
+
+// lossy merging of nearly identical tiles, if it was asked for
+TileAnalysis merge_tiles(TileAnalysis analysis)
+{
+	if(cfg.max_tiles > 0 || cfg.tolerance.has_value())
+		merge_near_duplicates(analysis, cfg.max_tiles,
+													cfg.tolerance.value_or(PIXELS_PER_TILE));
+	return analysis;
+}
+
+void write_shared_banks(ImageJob & job, TileAnalysis const & analysis,
+												size_t const bank_size, size_t const img_width_chr)
+{
+	if(cfg.vram_budget > 0)
+		write_tile_pool(job, analysis, bank_size, img_width_chr);
+	else
+		write_frame_deltas(job, analysis, bank_size, img_width_chr);
+}
+
+void process_optimized_stream(ImageJob & job, PngTileRowReader & reader,
+															size_t const bank_size)
+{
+	size_t const img_width_chr { reader.width_chr() };
+	bool by_bank { bank_size > 0 && (cfg.make_tilemaps || cfg.chr_by_bank) };
+	// banks which share tiles are split up only once the whole image is read
+	bool shared_banks { by_bank &&
+											(cfg.vram_budget > 0 || cfg.delta_slots > 0) };
+	bool whole_image { !by_bank || (by_bank && !cfg.chr_by_bank) ||
+										 shared_banks };
+
+	// tiles are fed to the analyzers one row of tiles at a time as the image is
+	// decoded; only the unique tiles are kept
+	TileAnalyzer image_analyzer;
+	TileAnalyzer bank_analyzer;
+	size_t bankidx { 0 };
+
+	while(reader.next_row())
+	{
+		TileView row_tiles { reader.tiles() };
+		for(size_t this_chr { 0 }; this_chr < row_tiles.size(); ++this_chr)
+		{
+			PackedChr const chr { row_tiles.get_packed(this_chr) };
+			if(whole_image)
+				image_analyzer.add(chr);
+			if(by_bank && !shared_banks)
+				bank_analyzer.add(chr);
+		}
+
+		// bank is complete, write it out and start on the next
+		// (any leftover rows that don't fill a full bank are ignored)
+		if(by_bank && !shared_banks && bank_analyzer.size() == bank_size)
+		{
+			bank_analyzer.finish();
+			auto out { make_bank_output(merge_tiles(bank_analyzer.result()),
+																	img_width_chr) };
+			write_bank(job, bankidx, out);
+
+			++bankidx;
+			bank_analyzer = TileAnalyzer(bank_size * bankidx);
+		}
+	}
+
+	if(whole_image)
+	{
+		image_analyzer.finish();
+		auto analysis { merge_tiles(image_analyzer.result()) };
+
+		if(shared_banks)
+		{
+			write_shared_banks(job, analysis, bank_size, img_width_chr);
+			return;
+		}
+
+		ostringstream tiles_out;
+		write_chrs(tiles_out, analysis);
+		write_image_chr(job, tiles_out.str());
+
+		if(!by_bank && cfg.make_tilemaps)
+		{
+			ostringstream map_out;
+			CodecChoice choice;
+			write_optimized_map(map_out, analysis, img_width_chr, &choice);
+			write_image_map(job, map_out.str(), choice);
+		}
+	}
+}
+
+// one of the codecs in the list, by name
+optional<Codec> find_codec(string const & name, vector<Codec> const & codecs)
+{
+	for(auto const codec : codecs)
+	{
+		if(codec_name(codec) == name)
+			return codec;
+	}
+	return nullopt;
 }
 
 void process_args(int argc, char ** argv)
@@ -268,6 +1245,7 @@ void process_args(int argc, char ** argv)
 	std::vector<option> long_opts {
 
 		{ "source", required_argument, nullptr, 's' },
+		{ "manifest", required_argument, nullptr, 'm' },
 		{ "output", required_argument, nullptr, 'o' },
 		{ "rows-per-bank", required_argument, nullptr, 'r' },
 		{ "tile-base", required_argument, nullptr, 'i' },
@@ -279,9 +1257,25 @@ void process_args(int argc, char ** argv)
 		{ "make-tilemap", no_argument, nullptr, 't' },
 		{ "width-header", no_argument, nullptr, 'w' },
 		{ "chirari-rle", no_argument, nullptr, 'e' },
+		{ "stream", no_argument, nullptr, 'S' },
+		{ "jobs", required_argument, nullptr, 'j' },
+		{ "threads", required_argument, nullptr, 'T' },
+		{ "cache", required_argument, nullptr, 'c' },
+		{ "shared-dict", no_argument, nullptr, 'd' },
+		{ "vram-budget", required_argument, nullptr, 'V' },
+		{ "delta-slots", required_argument, nullptr, 'D' },
+		{ "rom-layout", no_argument, nullptr, 'L' },
+		{ "rom-base", required_argument, nullptr, 'B' },
+		{ "incremental", no_argument, nullptr, 'I' },
+		{ "compress", required_argument, nullptr, 'C' },
+		{ "map-compress", required_argument, nullptr, 'M' },
+		{ "auto-compress", no_argument, nullptr, 'A' },
+		{ "byte-cost", required_argument, nullptr, 'K' },
+		{ "max-tiles", required_argument, nullptr, 'N' },
+		{ "tolerance", required_argument, nullptr, 'E' },
 		{ "help", no_argument, nullptr, 'h' }
 	};
-	std::string short_opts { ":s:o:r:i:l:pPzbtweh" };
+	std::string short_opts { ":s:m:o:r:i:l:pPzbtweSj:T:c:dV:D:LB:IC:M:AK:N:E:h" };
 
 	while(true)
 	{
@@ -292,10 +1286,31 @@ void process_args(int argc, char ** argv)
 
 		switch(this_opt)
 		{
+			// may be given more than once for batch mode
 			case 's':
-				cfg.in_image_path = optarg;
+				cfg.in_image_paths.push_back(optarg);
 				break;
 
+			// list of sources, one per line
+			case 'm':
+			{
+				ifstream manifest { optarg };
+				if(!manifest.good())
+				{
+					cerr << "Could not open manifest: " << optarg << endl;
+					exit(18);
+				}
+				string line;
+				while(getline(manifest, line))
+				{
+					// skip blank lines and comments
+					if(line.empty() || line[0] == '#')
+						continue;
+					cfg.in_image_paths.push_back(line);
+				}
+				break;
+			}
+
 			// output prefix
 			case 'o':
 				cfg.out_prefix = optarg;
@@ -377,6 +1392,185 @@ void process_args(int argc, char ** argv)
 				cfg.chirari_rle = true;
 				break;
 
+			case 'S':
+				cfg.stream = true;
+				break;
+
+			// number of worker threads for banked mode
+			case 'j':
+				try
+				{
+					int const jobs { stoi(optarg) };
+					if(jobs < 1)
+						throw out_of_range("");
+					cfg.jobs = (size_t)jobs;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for job count: " << optarg << endl;
+					exit(16);
+				}
+				break;
+
+			// number of worker threads for whole image analysis
+			case 'T':
+				try
+				{
+					int const threads { stoi(optarg) };
+					if(threads < 1)
+						throw out_of_range("");
+					cfg.threads = (size_t)threads;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for thread count: " << optarg << endl;
+					exit(17);
+				}
+				break;
+
+			// cache directory
+			case 'c':
+				cfg.cache_dir = optarg;
+				break;
+
+			case 'd':
+				cfg.shared_dict = true;
+				break;
+
+			// VRAM budget (in tiles) for a shared pool of tiles across banks
+			case 'V':
+				try
+				{
+					int const budget { stoi(optarg) };
+					if(budget < 1)
+						throw out_of_range("");
+					cfg.vram_budget = (size_t)budget;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for VRAM budget: " << optarg << endl;
+					exit(21);
+				}
+				break;
+
+			// number of VRAM slots for animation frames with delta uploads
+			case 'D':
+				try
+				{
+					int const slots { stoi(optarg) };
+					if(slots < 1)
+						throw out_of_range("");
+					cfg.delta_slots = (size_t)slots;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for delta slot count: " << optarg << endl;
+					exit(23);
+				}
+				break;
+
+			case 'L':
+				cfg.rom_layout = true;
+				break;
+
+			// ROM address of the packed chr (decimal, or hex with 0x)
+			case 'B':
+				try
+				{
+					long const rom_base { stol(optarg, nullptr, 0) };
+					if(rom_base < 0)
+						throw out_of_range("");
+					cfg.rom_base = (size_t)rom_base;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for ROM base address: " << optarg << endl;
+					exit(25);
+				}
+				break;
+
+			case 'I':
+				cfg.incremental = true;
+				break;
+
+			// chr compression
+			case 'C':
+			{
+				auto const codec { find_codec(optarg, CHR_CODECS) };
+				if(!codec.has_value())
+				{
+					cerr << "Invalid argument for chr compression: " << optarg << endl;
+					exit(27);
+				}
+				cfg.chr_codec = codec.value();
+				break;
+			}
+
+			// tilemap compression
+			case 'M':
+			{
+				auto const codec { find_codec(optarg, MAP_CODECS) };
+				if(!codec.has_value())
+				{
+					cerr << "Invalid argument for tilemap compression: " << optarg
+							 << endl;
+					exit(29);
+				}
+				cfg.map_codec = codec.value();
+				break;
+			}
+
+			case 'A':
+				cfg.auto_compress = true;
+				break;
+
+			// decompression cycles worth one byte of output, for --auto-compress
+			case 'K':
+				try
+				{
+					int const cost { stoi(optarg) };
+					if(cost < 0)
+						throw out_of_range("");
+					cfg.byte_cost = (size_t)cost;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for byte cost: " << optarg << endl;
+					exit(31);
+				}
+				break;
+
+			case 'N':
+				try
+				{
+					int const max_tiles { stoi(optarg) };
+					if(max_tiles < 0)
+						throw out_of_range("");
+					cfg.max_tiles = (size_t)max_tiles;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for maximum tiles: " << optarg << endl;
+					exit(32);
+				}
+				break;
+
+			// number of pixels a tile can be off by when merged with another
+			case 'E':
+				try
+				{
+					int const tolerance { stoi(optarg) };
+					if(tolerance < 0 || (size_t)tolerance > PIXELS_PER_TILE)
+						throw out_of_range("");
+					cfg.tolerance = (size_t)tolerance;
+				}
+				catch(const exception & ex)
+				{
+					cerr << "Invalid argument for tolerance: " << optarg << endl;
+					exit(33);
+				}
+				break;
+
 			// help
 			case 'h':
 				print_help();
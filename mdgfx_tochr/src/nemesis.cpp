@@ -0,0 +1,467 @@
+#include "nemesis.hpp"
+#include "workpool.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+// Nemesis format:
+// a word header: bit 15 set for XOR mode, the rest the number of tiles
+// then the code table, made of these, ended by 0xff:
+//  1000nnnn - following codes are for pixel value n
+//  0cccllll xxxxxxxx - code xxxxxxxx (the low l bits) for c+1 pixels
+// then the codes for the pixels as a bitstream, high bit first
+// a code of 111111 is followed by the run inline: ccc nnnn, for c+1 pixels of
+// value n, so no code in the table can start with that
+// runs carry on across rows; in XOR mode each row is XORed with the one
+// before it once decoded
+
+// a run of one pixel value, as an index of value * 8 + (count - 1)
+constexpr size_t SYMBOL_COUNT { 16 * 8 };
+constexpr size_t MAX_RUN { 8 };
+
+constexpr size_t MAX_CODE_LENGTH { 8 };
+constexpr u8 INLINE_CODE { 0x3f };
+constexpr size_t INLINE_CODE_LENGTH { 6 };
+constexpr size_t INLINE_LENGTH { INLINE_CODE_LENGTH + 7 };
+// codes are placed in an 8 bit space, the top of which is taken by the
+// inline code
+constexpr size_t CODE_SPACE { (1 << MAX_CODE_LENGTH) -
+															(1 << (MAX_CODE_LENGTH - INLINE_CODE_LENGTH)) };
+// each entry in the table costs two bytes
+constexpr size_t TABLE_ENTRY_BITS { 16 };
+
+constexpr u16 XOR_MODE { 0x8000 };
+constexpr size_t MAX_TILES { 0x7fff };
+constexpr size_t ROWS_PER_TILE { 8 };
+
+// 68000 cycles for each part of the standard decompressor (NemDec), from the
+// timings of the instructions involved
+constexpr size_t CYCLES_TABLE_ENTRY { 60 };
+constexpr size_t CYCLES_TABLE_FILL { 12 };
+constexpr size_t CYCLES_CODE { 70 };
+constexpr size_t CYCLES_INLINE { 90 };
+constexpr size_t CYCLES_PIXEL { 24 };
+constexpr size_t CYCLES_ROW { 44 };
+constexpr size_t CYCLES_XOR_ROW { 8 };
+
+class BitWriter
+{
+public:
+	BitWriter(vector<u8> & out) : m_out(out), m_bits(0), m_bitcount(0) {}
+
+	void put(u32 value, size_t length)
+	{
+		m_bits = (m_bits << length) | (value & ((1 << length) - 1));
+		m_bitcount += length;
+		while(m_bitcount >= 8)
+		{
+			m_bitcount -= 8;
+			m_out.push_back((u8)(m_bits >> m_bitcount));
+		}
+	}
+
+	// pads out the last byte with zeroes
+	void flush()
+	{
+		if(m_bitcount > 0)
+			put(0, 8 - m_bitcount);
+	}
+
+private:
+	vector<u8> & m_out;
+	u32 m_bits;
+	size_t m_bitcount;
+};
+
+class BitReader
+{
+public:
+	BitReader(u8 const * data, size_t size) :
+			m_data(data), m_size(size), m_bitpos(0)
+	{
+	}
+
+	// the next 8 bits, without using them up (zeroes past the end)
+	u8 peek8() const
+	{
+		size_t const byte { m_bitpos / 8 }, shift { m_bitpos % 8 };
+		u16 window { 0 };
+		if(byte < m_size)
+			window = m_data[byte] << 8;
+		if(byte + 1 < m_size)
+			window |= m_data[byte + 1];
+		return (u8)(window >> (8 - shift));
+	}
+
+	u32 get(size_t length)
+	{
+		u32 value { 0 };
+		for(size_t this_bit { 0 }; this_bit < length; ++this_bit)
+			value = (value << 1) | next_bit();
+		return value;
+	}
+
+	void skip(size_t length)
+	{
+		if(m_bitpos + length > m_size * 8)
+			throw runtime_error("Nemesis data ends early");
+		m_bitpos += length;
+	}
+
+private:
+	u32 next_bit()
+	{
+		if(m_bitpos >= m_size * 8)
+			throw runtime_error("Nemesis data ends early");
+		u32 const bit = (m_data[m_bitpos / 8] >> (7 - (m_bitpos % 8))) & 1;
+		++m_bitpos;
+		return bit;
+	}
+
+	u8 const * m_data;
+	size_t m_size;
+	size_t m_bitpos;
+};
+
+// length (0 if the run is written inline) and code for each symbol
+struct CodeTable
+{
+	array<u8, SYMBOL_COUNT> lengths;
+	array<u8, SYMBOL_COUNT> codes;
+};
+
+vector<u32> read_rows(u8 const * data, size_t size, bool xor_mode)
+{
+	vector<u32> rows(size / 4);
+	u32 prev_row { 0 };
+	for(size_t this_row { 0 }; this_row < rows.size(); ++this_row)
+	{
+		u8 const * in { data + this_row * 4 };
+		u32 const row = ((u32)in[0] << 24) | ((u32)in[1] << 16) |
+										((u32)in[2] << 8) | in[3];
+		rows[this_row] = xor_mode ? row ^ prev_row : row;
+		prev_row = row;
+	}
+	return rows;
+}
+
+vector<u8> make_runs(vector<u32> const & rows)
+{
+	vector<u8> runs;
+	size_t run_value { 0 }, run_count { 0 };
+	for(auto const row : rows)
+	{
+		for(int shift { 28 }; shift >= 0; shift -= 4)
+		{
+			size_t const pixel { (row >> shift) & 0xf };
+			if(run_count > 0 && (pixel != run_value || run_count == MAX_RUN))
+			{
+				runs.push_back(run_value * MAX_RUN + run_count - 1);
+				run_count = 0;
+			}
+			run_value = pixel;
+			++run_count;
+		}
+	}
+	if(run_count > 0)
+		runs.push_back(run_value * MAX_RUN + run_count - 1);
+	return runs;
+}
+
+// picks the code lengths with the fewest total bits, counting the table
+// entries and the runs left to be written inline
+// with the symbols sorted by how often they're used, the best lengths never go
+// down, and the inline runs are always the least used, so this is a search
+// over the symbols in that order, the code space used so far and the last
+// length
+CodeTable make_code_table(array<size_t, SYMBOL_COUNT> const & counts)
+{
+	vector<u8> symbols;
+	for(size_t this_symbol { 0 }; this_symbol < SYMBOL_COUNT; ++this_symbol)
+		if(counts[this_symbol] > 0)
+			symbols.push_back(this_symbol);
+	stable_sort(symbols.begin(), symbols.end(),
+							[&](u8 a, u8 b) { return counts[a] > counts[b]; });
+	size_t const symbol_count { symbols.size() };
+
+	// bits needed to write every symbol from here on inline
+	vector<size_t> inline_bits(symbol_count + 1, 0);
+	for(size_t this_symbol { symbol_count }; this_symbol-- > 0;)
+		inline_bits[this_symbol] = inline_bits[this_symbol + 1] +
+															 counts[symbols[this_symbol]] * INLINE_LENGTH;
+
+	size_t const never { numeric_limits<size_t>::max() };
+	size_t const space_states { CODE_SPACE + 1 },
+			length_states { MAX_CODE_LENGTH + 1 };
+	auto state = [&](size_t symbol, size_t space, size_t length) {
+		return (symbol * space_states + space) * length_states + length;
+	};
+	vector<size_t> best((symbol_count + 1) * space_states * length_states, never);
+	vector<u8> chosen_length(best.size(), 0);
+
+	// best[state] is the fewest bits for the symbols before this one, having
+	// used that much code space with codes no longer than that length
+	best[state(0, 0, 1)] = 0;
+	size_t best_total { inline_bits[0] };
+	size_t best_end { state(0, 0, 1) };
+
+	for(size_t this_symbol { 0 }; this_symbol < symbol_count; ++this_symbol)
+	{
+		size_t const count { counts[symbols[this_symbol]] };
+		for(size_t space { 0 }; space <= CODE_SPACE; ++space)
+		{
+			for(size_t last_length { 1 }; last_length <= MAX_CODE_LENGTH;
+					++last_length)
+			{
+				size_t const bits { best[state(this_symbol, space, last_length)] };
+				if(bits == never)
+					continue;
+
+				for(size_t length { last_length }; length <= MAX_CODE_LENGTH; ++length)
+				{
+					size_t const used { space + (1 << (MAX_CODE_LENGTH - length)) };
+					if(used > CODE_SPACE)
+						continue;
+					size_t const next_bits { bits + count * length + TABLE_ENTRY_BITS };
+					size_t const next { state(this_symbol + 1, used, length) };
+					if(next_bits < best[next])
+					{
+						best[next] = next_bits;
+						chosen_length[next] = last_length;
+					}
+				}
+			}
+		}
+	}
+
+	// the table can stop after any symbol, with the rest written inline
+	for(size_t this_symbol { 1 }; this_symbol <= symbol_count; ++this_symbol)
+		for(size_t space { 0 }; space <= CODE_SPACE; ++space)
+			for(size_t length { 1 }; length <= MAX_CODE_LENGTH; ++length)
+			{
+				size_t const end { state(this_symbol, space, length) };
+				if(best[end] == never)
+					continue;
+				size_t const total { best[end] + inline_bits[this_symbol] };
+				if(total < best_total)
+				{
+					best_total = total;
+					best_end = end;
+				}
+			}
+
+	// walk back through the choices to get the length of each symbol
+	CodeTable table;
+	table.lengths.fill(0);
+	table.codes.fill(0);
+	size_t symbol_end { best_end / (space_states * length_states) },
+			space { (best_end / length_states) % space_states },
+			length { best_end % length_states };
+	vector<u8> table_symbols;
+	for(size_t this_symbol { symbol_end }; this_symbol-- > 0;)
+	{
+		u8 const symbol { symbols[this_symbol] };
+		table.lengths[symbol] = length;
+		table_symbols.push_back(symbol);
+		size_t const prev_length { chosen_length[state(this_symbol + 1, space,
+																									 length)] };
+		space -= 1 << (MAX_CODE_LENGTH - length);
+		length = prev_length;
+	}
+
+	// canonical codes, shortest first, counting up from zero so they stay
+	// clear of the inline code at the top
+	stable_sort(table_symbols.begin(), table_symbols.end(), [&](u8 a, u8 b) {
+		return table.lengths[a] < table.lengths[b];
+	});
+	size_t next_code { 0 };
+	for(auto const symbol : table_symbols)
+	{
+		size_t const shift { MAX_CODE_LENGTH - table.lengths[symbol] };
+		table.codes[symbol] = next_code >> shift;
+		next_code += 1 << shift;
+	}
+
+	return table;
+}
+
+vector<u8> encode_mode(u8 const * data, size_t size, bool xor_mode)
+{
+	auto const runs { make_runs(read_rows(data, size, xor_mode)) };
+
+	array<size_t, SYMBOL_COUNT> counts {};
+	for(auto const run : runs)
+		++counts[run];
+	auto const table { make_code_table(counts) };
+
+	vector<u8> out;
+	size_t const tile_count { size / (ROWS_PER_TILE * 4) };
+	u16 const header = tile_count | (xor_mode ? XOR_MODE : 0);
+	out.push_back(header >> 8);
+	out.push_back(header & 0xff);
+
+	// table entries are grouped by pixel value
+	for(size_t value { 0 }; value < 16; ++value)
+	{
+		bool value_set { false };
+		for(size_t count { 0 }; count < MAX_RUN; ++count)
+		{
+			size_t const symbol { value * MAX_RUN + count };
+			if(table.lengths[symbol] == 0)
+				continue;
+			if(!value_set)
+			{
+				out.push_back(0x80 | value);
+				value_set = true;
+			}
+			out.push_back((count << 4) | table.lengths[symbol]);
+			out.push_back(table.codes[symbol]);
+		}
+	}
+	out.push_back(0xff);
+
+	BitWriter bits { out };
+	for(auto const run : runs)
+	{
+		if(table.lengths[run] > 0)
+			bits.put(table.codes[run], table.lengths[run]);
+		else
+		{
+			bits.put(INLINE_CODE, INLINE_CODE_LENGTH);
+			bits.put(((run % MAX_RUN) << 4) | (run / MAX_RUN), 7);
+		}
+	}
+	bits.flush();
+
+	return out;
+}
+} // namespace
+
+bool nemesis_fits(size_t size)
+{
+	return size % (ROWS_PER_TILE * 4) == 0 &&
+				 size / (ROWS_PER_TILE * 4) <= MAX_TILES;
+}
+
+vector<u8> nemesis_encode(u8 const * data, size_t size, size_t const threads)
+{
+	if(size % (ROWS_PER_TILE * 4) != 0)
+		throw invalid_argument("Nemesis data must be whole tiles");
+	if(size / (ROWS_PER_TILE * 4) > MAX_TILES)
+		throw out_of_range("Too many tiles for Nemesis compression (max " +
+											 to_string(MAX_TILES) + ")");
+
+	// try both modes, keeping the plain one on a tie
+	vector<u8> encoded[2];
+	parallel_for(2, threads, [&](size_t mode) {
+		encoded[mode] = encode_mode(data, size, mode == 1);
+	});
+
+	return encoded[1].size() < encoded[0].size() ? encoded[1] : encoded[0];
+}
+
+vector<u8> nemesis_decode(u8 const * data, size_t size, size_t * cycles)
+{
+	if(size < 3)
+		throw runtime_error("Nemesis data is too short");
+
+	u16 const header = (data[0] << 8) | data[1];
+	bool const xor_mode { (header & XOR_MODE) != 0 };
+	size_t const row_count { (header & MAX_TILES) * ROWS_PER_TILE };
+
+	// codes are looked up by the next 8 bits of data, as on the hardware
+	struct CodeEntry
+	{
+		u8 length;
+		u8 value;
+		u8 count;
+	};
+	array<CodeEntry, 1 << MAX_CODE_LENGTH> lookup {};
+
+	size_t pos { 2 }, spent { 0 };
+	auto next_byte = [&]() {
+		if(pos >= size)
+			throw runtime_error("Nemesis code table ends early");
+		return data[pos++];
+	};
+
+	u8 value { 0 };
+	for(u8 table_byte { next_byte() }; table_byte != 0xff;
+			table_byte = next_byte())
+	{
+		if(table_byte & 0x80)
+		{
+			value = table_byte & 0xf;
+			continue;
+		}
+		size_t const length { table_byte & 0xfu };
+		u8 const count = ((table_byte >> 4) & 7) + 1;
+		u8 const code { next_byte() };
+		if(length == 0 || length > MAX_CODE_LENGTH)
+			throw runtime_error("Nemesis code table has an invalid code length");
+		size_t const shift { MAX_CODE_LENGTH - length };
+		size_t const first { (size_t)(code << shift) & 0xff };
+		for(size_t this_entry { 0 }; this_entry < ((size_t)1 << shift);
+				++this_entry)
+			lookup[first + this_entry] = CodeEntry { (u8)length, value, count };
+		spent += CYCLES_TABLE_ENTRY + CYCLES_TABLE_FILL * ((size_t)1 << shift);
+	}
+
+	vector<u8> out;
+	out.reserve(row_count * 4);
+	BitReader bits { data + pos, size - pos };
+	u32 row { 0 }, prev_row { 0 };
+	size_t row_pixels { 0 };
+	while(out.size() < row_count * 4)
+	{
+		u8 const window { bits.peek8() };
+		u8 run_value, run_count;
+		if((window >> (MAX_CODE_LENGTH - INLINE_CODE_LENGTH)) == INLINE_CODE)
+		{
+			bits.skip(INLINE_CODE_LENGTH);
+			u32 const inline_run { bits.get(7) };
+			run_count = (inline_run >> 4) + 1;
+			run_value = inline_run & 0xf;
+			spent += CYCLES_INLINE;
+		}
+		else
+		{
+			auto const & entry { lookup[window] };
+			if(entry.length == 0)
+				throw runtime_error("Nemesis data has a code not in the table");
+			bits.skip(entry.length);
+			run_count = entry.count;
+			run_value = entry.value;
+			spent += CYCLES_CODE;
+		}
+
+		for(; run_count > 0 && out.size() < row_count * 4; --run_count)
+		{
+			row = (row << 4) | run_value;
+			spent += CYCLES_PIXEL;
+			if(++row_pixels < 8)
+				continue;
+			spent += CYCLES_ROW;
+			if(xor_mode)
+			{
+				row ^= prev_row;
+				spent += CYCLES_XOR_ROW;
+			}
+			for(int shift { 24 }; shift >= 0; shift -= 8)
+				out.push_back((u8)(row >> shift));
+			prev_row = row;
+			row = 0;
+			row_pixels = 0;
+		}
+	}
+
+	if(cycles != nullptr)
+		*cycles = spent;
+	return out;
+}
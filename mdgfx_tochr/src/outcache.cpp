@@ -0,0 +1,153 @@
+#include "outcache.hpp"
+#include "common.hpp"
+#include "zlib.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace
+{
+// files within each cache entry
+char const * const MANIFEST_NAME { "outputs" };
+char const * const SETTINGS_NAME { "settings" };
+char const * const OUTPUT_NAME { "out" };
+
+// numbers the temporary entries made within this process, as batch mode may
+// store the same entry from more than one thread at once
+atomic<unsigned> temp_entry_count { 0 };
+
+// outputs are hard linked from the cache where possible, falling back to a
+// copy (e.g. when the cache is on another file system)
+void link_or_copy(fs::path const & from, fs::path const & to)
+{
+	error_code err;
+	fs::remove(to, err);
+	fs::create_hard_link(from, to, err);
+	if(err)
+		fs::copy_file(from, to, fs::copy_options::overwrite_existing);
+}
+} // namespace
+
+OutputCache::OutputCache(string const & cache_dir, string const & source_path,
+												 string const & settings) :
+		m_cache_dir(cache_dir), m_settings(settings)
+{
+	ifstream source { source_path, ios::binary };
+	if(!source.good())
+		throw runtime_error(strerror(errno));
+
+	// the key is made from the size, CRC32 and Adler32 of the source file,
+	// which are cheap enough to not matter next to decoding the image, plus
+	// the CRC32 of the settings
+	uLong source_crc { crc32(0L, Z_NULL, 0) };
+	uLong source_adler { adler32(0L, Z_NULL, 0) };
+	u64 source_size { 0 };
+
+	vector<char> buffer(0x10000);
+	while(source)
+	{
+		source.read(buffer.data(), buffer.size());
+		auto const read_size { source.gcount() };
+		if(read_size <= 0)
+			break;
+		source_crc = crc32(source_crc, (Bytef *)buffer.data(), (uInt)read_size);
+		source_adler =
+				adler32(source_adler, (Bytef *)buffer.data(), (uInt)read_size);
+		source_size += read_size;
+	}
+	if(source.bad())
+		throw runtime_error("Failed to read source for cache key");
+
+	uLong const settings_crc { crc32(crc32(0L, Z_NULL, 0),
+																	 (Bytef const *)settings.data(),
+																	 (uInt)settings.size()) };
+
+	stringstream key;
+	key << hex << setfill('0') << setw(8) << source_crc << setw(8)
+			<< source_adler << '-' << source_size << '-' << setw(8)
+			<< settings_crc;
+
+	m_entry_path = (fs::path(m_cache_dir) / key.str()).string();
+}
+
+bool OutputCache::restore(string const & out_prefix) const
+{
+	fs::path const entry { m_entry_path };
+
+	// the settings are kept alongside the outputs and checked on a hit, so
+	// a collision in the settings CRC can't return the wrong files
+	ifstream settings_in { entry / SETTINGS_NAME, ios::binary };
+	if(!settings_in.good())
+		return false;
+	string cached_settings { istreambuf_iterator<char>(settings_in),
+													 istreambuf_iterator<char>() };
+	if(cached_settings != m_settings)
+		return false;
+
+	ifstream manifest { entry / MANIFEST_NAME };
+	if(!manifest.good())
+		return false;
+
+	vector<string> suffixes;
+	string suffix;
+	while(getline(manifest, suffix))
+		suffixes.push_back(suffix);
+
+	// make sure the whole entry is there before touching any outputs
+	for(auto const & this_suffix : suffixes)
+		if(!fs::exists(entry / (OUTPUT_NAME + this_suffix)))
+			return false;
+
+	for(auto const & this_suffix : suffixes)
+		link_or_copy(entry / (OUTPUT_NAME + this_suffix), out_prefix + this_suffix);
+
+	return true;
+}
+
+void OutputCache::store(string const & out_prefix,
+												vector<string> const & suffixes) const
+{
+	// the entry is built under a temporary name and moved into place once it's
+	// complete, so other processes or threads sharing the cache never see a
+	// partial entry (the name is unique to this call, so they never share one
+	// while it's being built either)
+	fs::create_directories(m_cache_dir);
+	fs::path const temp_entry { m_entry_path + ".tmp" + to_string(getpid()) +
+															"-" + to_string(temp_entry_count++) };
+	fs::remove_all(temp_entry);
+	fs::create_directory(temp_entry);
+
+	// outputs are copied in rather than linked, so changes to the output files
+	// after this point don't end up in the cache
+	for(auto const & this_suffix : suffixes)
+		fs::copy_file(out_prefix + this_suffix,
+									temp_entry / (OUTPUT_NAME + this_suffix));
+
+	{
+		ofstream manifest { temp_entry / MANIFEST_NAME };
+		for(auto const & this_suffix : suffixes)
+			manifest << this_suffix << '\n';
+
+		ofstream settings_out { temp_entry / SETTINGS_NAME, ios::binary };
+		settings_out << m_settings;
+
+		if(!manifest.good() || !settings_out.good())
+			throw runtime_error("Failed to write cache entry");
+	}
+
+	// if another process or thread stored the same entry in the meantime, keep
+	// theirs
+	error_code err;
+	fs::rename(temp_entry, m_entry_path, err);
+	if(err)
+		fs::remove_all(temp_entry, err);
+}
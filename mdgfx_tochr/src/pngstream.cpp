@@ -0,0 +1,127 @@
+#include "pngstream.hpp"
+#include <cerrno>
+#include <csetjmp>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+void PngTileRowReader::on_error(png_structp png, png_const_charp msg)
+{
+	// libpng errors can't return, so stash the message and jump back to
+	// where we can safely throw it
+	auto reader { (PngTileRowReader *)png_get_error_ptr(png) };
+	reader->m_error = msg;
+	longjmp(png_jmpbuf(png), 1);
+}
+
+PngTileRowReader::PngTileRowReader(string const & path) :
+		m_file(nullptr), m_png(nullptr), m_info(nullptr), m_width(0),
+		m_height_chr(0), m_rows_read(0)
+{
+	m_file = fopen(path.c_str(), "rb");
+	if(m_file == nullptr)
+		throw runtime_error(strerror(errno));
+
+	m_png = png_create_read_struct(PNG_LIBPNG_VER_STRING, this, on_error,
+																 nullptr);
+	if(m_png != nullptr)
+		m_info = png_create_info_struct(m_png);
+	if(m_info == nullptr)
+	{
+		close();
+		throw runtime_error("Could not initialize libpng");
+	}
+
+	if(setjmp(png_jmpbuf(m_png)))
+	{
+		close();
+		throw runtime_error(m_error);
+	}
+
+	png_init_io(m_png, m_file);
+	png_read_info(m_png, m_info);
+
+	if(png_get_color_type(m_png, m_info) != PNG_COLOR_TYPE_PALETTE)
+		m_error = "Image must be paletted (indexed color)";
+	else if(png_get_interlace_type(m_png, m_info) != PNG_INTERLACE_NONE)
+		m_error = "Interlaced images cannot be streamed";
+	if(!m_error.empty())
+	{
+		close();
+		throw runtime_error(m_error);
+	}
+
+	// expand 1/2/4bpp images to 1 byte per pixel
+	if(png_get_bit_depth(m_png, m_info) < 8)
+		png_set_packing(m_png);
+	png_read_update_info(m_png, m_info);
+
+	png_colorp pal;
+	int pal_size { 0 };
+	png_get_PLTE(m_png, m_info, &pal, &pal_size);
+	for(int this_color { 0 }; this_color < pal_size; ++this_color)
+		m_palette.push_back(png::color(pal[this_color].red, pal[this_color].green,
+																	 pal[this_color].blue));
+
+	m_width = png_get_image_width(m_png, m_info);
+	m_height_chr = png_get_image_height(m_png, m_info) / BASIC_CHR_HEIGHT;
+	m_pixels.resize(m_width * BASIC_CHR_HEIGHT);
+}
+
+PngTileRowReader::~PngTileRowReader()
+{
+	close();
+}
+
+void PngTileRowReader::close()
+{
+	if(m_png != nullptr)
+		png_destroy_read_struct(&m_png, m_info != nullptr ? &m_info : nullptr,
+														nullptr);
+	m_png = nullptr;
+	m_info = nullptr;
+	if(m_file != nullptr)
+		fclose(m_file);
+	m_file = nullptr;
+}
+
+size_t PngTileRowReader::width_chr() const
+{
+	return m_width / BASIC_CHR_WIDTH;
+}
+
+size_t PngTileRowReader::height_chr() const
+{
+	return m_height_chr;
+}
+
+png::palette const & PngTileRowReader::palette() const
+{
+	return m_palette;
+}
+
+bool PngTileRowReader::next_row()
+{
+	// any scanlines past the last full row of tiles are ignored
+	if(m_rows_read == m_height_chr)
+		return false;
+
+	if(setjmp(png_jmpbuf(m_png)))
+		throw runtime_error(m_error);
+
+	for(size_t this_line { 0 }; this_line < BASIC_CHR_HEIGHT; ++this_line)
+		png_read_row(m_png, m_pixels.data() + (this_line * m_width), nullptr);
+
+	++m_rows_read;
+	return true;
+}
+
+TileView PngTileRowReader::tiles() const
+{
+	vector<byte_t const *> rows;
+	rows.reserve(BASIC_CHR_HEIGHT);
+	for(size_t this_line { 0 }; this_line < BASIC_CHR_HEIGHT; ++this_line)
+		rows.push_back(m_pixels.data() + (this_line * m_width));
+	return TileView(rows, m_width);
+}
@@ -0,0 +1,93 @@
+#include "romlayout.hpp"
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+RomLayout plan_rom_layout(vector<size_t> const & block_sizes,
+													size_t const rom_base, size_t const boundary)
+{
+	// the area is split into sections at each boundary; the first may be short
+	// if the area doesn't start on a boundary
+	size_t const first_capacity { boundary - (rom_base % boundary) };
+
+	for(size_t this_block { 0 }; this_block < block_sizes.size(); ++this_block)
+	{
+		if(block_sizes[this_block] > boundary)
+		{
+			stringstream ss;
+			ss << "Block " << this_block << " is " << block_sizes[this_block]
+				 << " bytes, which cannot fit between DMA boundaries";
+			throw runtime_error(ss.str());
+		}
+	}
+
+	// first fit decreasing: biggest blocks first, each into the first section
+	// it fits in (ties keep their original order)
+	vector<size_t> order(block_sizes.size());
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return block_sizes[a] > block_sizes[b];
+	});
+
+	// (the first section always exists, even if nothing fits in it)
+	vector<size_t> section_used(1, 0);
+	vector<vector<size_t>> section_blocks(1);
+	for(auto const this_block : order)
+	{
+		size_t this_section { 0 };
+		for(; this_section < section_used.size(); ++this_section)
+		{
+			size_t const capacity { this_section == 0 ? first_capacity : boundary };
+			if(section_used[this_section] + block_sizes[this_block] <= capacity)
+				break;
+		}
+		if(this_section == section_used.size())
+		{
+			section_used.push_back(0);
+			section_blocks.emplace_back();
+		}
+		section_used[this_section] += block_sizes[this_block];
+		section_blocks[this_section].push_back(this_block);
+	}
+
+	// every section but the last is padded out to the next boundary, so put the
+	// emptiest one at the end (the first section has to stay first)
+	if(section_used.size() > 2)
+	{
+		auto const i_emptiest { min_element(section_used.begin() + 1,
+																				section_used.end()) };
+		size_t const emptiest { (size_t)(i_emptiest - section_used.begin()) };
+		rotate(section_used.begin() + emptiest, section_used.begin() + emptiest + 1,
+					 section_used.end());
+		rotate(section_blocks.begin() + emptiest,
+					 section_blocks.begin() + emptiest + 1, section_blocks.end());
+	}
+
+	RomLayout layout;
+	layout.offsets.resize(block_sizes.size());
+	layout.size = 0;
+
+	size_t section_start { 0 };
+	for(size_t this_section { 0 }; this_section < section_blocks.size();
+			++this_section)
+	{
+		// blocks within a section go back to their original order
+		auto & blocks { section_blocks[this_section] };
+		sort(blocks.begin(), blocks.end());
+
+		size_t offset { section_start };
+		for(auto const this_block : blocks)
+		{
+			layout.offsets[this_block] = offset;
+			offset += block_sizes[this_block];
+		}
+		layout.size = offset;
+
+		section_start += this_section == 0 ? first_capacity : boundary;
+	}
+
+	return layout;
+}
@@ -0,0 +1,190 @@
+#include "tilekernels.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MDGFX_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+bool is_blank_tile_scalar(PackedChr const & chr)
+{
+	u32 all { 0 };
+	for(auto row : chr.rows)
+		all |= row;
+	return all == 0;
+}
+
+bool is_flat_tile_scalar(PackedChr const & chr)
+{
+	// every nibble in every row must match the first pixel
+	u32 const flatrow { (chr.rows[0] >> 28) * 0x11111111 };
+	for(auto row : chr.rows)
+		if(row != flatrow)
+			return false;
+	return true;
+}
+
+bool is_identical_tile_scalar(PackedChr const & chr1, PackedChr const & chr2)
+{
+	// compare as four 64 bit words
+	u64 words1[4], words2[4];
+	memcpy(words1, chr1.rows, PACKED_CHR_BYTESZ);
+	memcpy(words2, chr2.rows, PACKED_CHR_BYTESZ);
+	return words1[0] == words2[0] && words1[1] == words2[1] &&
+				 words1[2] == words2[2] && words1[3] == words2[3];
+}
+
+void v_flip_tile_scalar(PackedChr & chr)
+{
+	reverse(begin(chr.rows), end(chr.rows));
+}
+
+void h_flip_tile_scalar(PackedChr & chr)
+{
+	// reverse the pixels in each row: swap the nibbles within each byte, then
+	// reverse the bytes
+	for(auto & row : chr.rows)
+	{
+		row = ((row >> 4) & 0x0f0f0f0f) | ((row & 0x0f0f0f0f) << 4);
+		row = (row >> 24) | ((row >> 8) & 0xff00) | ((row << 8) & 0xff0000) |
+					(row << 24);
+	}
+}
+
+#ifdef MDGFX_X86
+
+// packed tiles are 32 bytes, which is two SSE2 registers of four rows each or
+// one AVX2 register
+
+__attribute__((target("sse2"))) bool is_blank_tile_sse2(PackedChr const & chr)
+{
+	__m128i const * in { (__m128i const *)chr.rows };
+	__m128i const all { _mm_or_si128(_mm_loadu_si128(in),
+																	 _mm_loadu_si128(in + 1)) };
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(all, _mm_setzero_si128())) == 0xffff;
+}
+
+__attribute__((target("sse2"))) bool is_flat_tile_sse2(PackedChr const & chr)
+{
+	__m128i const * in { (__m128i const *)chr.rows };
+	__m128i const flatrow { _mm_set1_epi32(
+			(int)((chr.rows[0] >> 28) * 0x11111111)) };
+	__m128i const same { _mm_and_si128(
+			_mm_cmpeq_epi32(_mm_loadu_si128(in), flatrow),
+			_mm_cmpeq_epi32(_mm_loadu_si128(in + 1), flatrow)) };
+	return _mm_movemask_epi8(same) == 0xffff;
+}
+
+__attribute__((target("sse2"))) bool
+is_identical_tile_sse2(PackedChr const & chr1, PackedChr const & chr2)
+{
+	__m128i const * in1 { (__m128i const *)chr1.rows };
+	__m128i const * in2 { (__m128i const *)chr2.rows };
+	__m128i const same { _mm_and_si128(
+			_mm_cmpeq_epi8(_mm_loadu_si128(in1), _mm_loadu_si128(in2)),
+			_mm_cmpeq_epi8(_mm_loadu_si128(in1 + 1), _mm_loadu_si128(in2 + 1))) };
+	return _mm_movemask_epi8(same) == 0xffff;
+}
+
+__attribute__((target("sse2"))) void v_flip_tile_sse2(PackedChr & chr)
+{
+	// reverse the rows within each register, then swap the registers
+	__m128i * io { (__m128i *)chr.rows };
+	__m128i const rows0123 { _mm_loadu_si128(io) },
+			rows4567 { _mm_loadu_si128(io + 1) };
+	_mm_storeu_si128(io, _mm_shuffle_epi32(rows4567, _MM_SHUFFLE(0, 1, 2, 3)));
+	_mm_storeu_si128(io + 1,
+									 _mm_shuffle_epi32(rows0123, _MM_SHUFFLE(0, 1, 2, 3)));
+}
+
+__attribute__((target("sse2"))) void h_flip_tile_sse2(PackedChr & chr)
+{
+	// swap the nibbles within each byte, then (as there's no byte shuffle in
+	// SSE2) swap the bytes in each word and the words in each row
+	__m128i const low_nibbles { _mm_set1_epi8(0x0f) };
+	__m128i * io { (__m128i *)chr.rows };
+	for(u8 this_reg { 0 }; this_reg < 2; ++this_reg)
+	{
+		__m128i rows { _mm_loadu_si128(io + this_reg) };
+		rows = _mm_or_si128(
+				_mm_and_si128(_mm_srli_epi16(rows, 4), low_nibbles),
+				_mm_slli_epi16(_mm_and_si128(rows, low_nibbles), 4));
+		rows = _mm_or_si128(_mm_slli_epi16(rows, 8), _mm_srli_epi16(rows, 8));
+		rows = _mm_shufflelo_epi16(rows, _MM_SHUFFLE(2, 3, 0, 1));
+		rows = _mm_shufflehi_epi16(rows, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128(io + this_reg, rows);
+	}
+}
+
+__attribute__((target("avx2"))) bool is_blank_tile_avx2(PackedChr const & chr)
+{
+	__m256i const all { _mm256_loadu_si256((__m256i const *)chr.rows) };
+	return _mm256_testz_si256(all, all);
+}
+
+__attribute__((target("avx2"))) bool is_flat_tile_avx2(PackedChr const & chr)
+{
+	__m256i const flatrow { _mm256_set1_epi32(
+			(int)((chr.rows[0] >> 28) * 0x11111111)) };
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi32(
+						 _mm256_loadu_si256((__m256i const *)chr.rows), flatrow)) == -1;
+}
+
+__attribute__((target("avx2"))) bool
+is_identical_tile_avx2(PackedChr const & chr1, PackedChr const & chr2)
+{
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+						 _mm256_loadu_si256((__m256i const *)chr1.rows),
+						 _mm256_loadu_si256((__m256i const *)chr2.rows))) == -1;
+}
+
+__attribute__((target("avx2"))) void v_flip_tile_avx2(PackedChr & chr)
+{
+	__m256i * io { (__m256i *)chr.rows };
+	_mm256_storeu_si256(
+			io, _mm256_permutevar8x32_epi32(_mm256_loadu_si256(io),
+																			_mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+}
+
+__attribute__((target("avx2"))) void h_flip_tile_avx2(PackedChr & chr)
+{
+	// swap the nibbles within each byte, then reverse the bytes of each row
+	// with a single shuffle
+	__m256i const low_nibbles { _mm256_set1_epi8(0x0f) };
+	__m256i const row_reverse { _mm256_setr_epi8(
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5,
+			4, 11, 10, 9, 8, 15, 14, 13, 12) };
+	__m256i * io { (__m256i *)chr.rows };
+	__m256i rows { _mm256_loadu_si256(io) };
+	rows = _mm256_or_si256(
+			_mm256_and_si256(_mm256_srli_epi16(rows, 4), low_nibbles),
+			_mm256_slli_epi16(_mm256_and_si256(rows, low_nibbles), 4));
+	_mm256_storeu_si256(io, _mm256_shuffle_epi8(rows, row_reverse));
+}
+
+#endif
+} // namespace
+
+vector<TileKernels> available_kernels()
+{
+	vector<TileKernels> kernels { { "scalar", is_blank_tile_scalar,
+																	is_flat_tile_scalar, is_identical_tile_scalar,
+																	v_flip_tile_scalar, h_flip_tile_scalar } };
+#ifdef MDGFX_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		kernels.push_back({ "sse2", is_blank_tile_sse2, is_flat_tile_sse2,
+												is_identical_tile_sse2, v_flip_tile_sse2,
+												h_flip_tile_sse2 });
+	if(__builtin_cpu_supports("avx2"))
+		kernels.push_back({ "avx2", is_blank_tile_avx2, is_flat_tile_avx2,
+												is_identical_tile_avx2, v_flip_tile_avx2,
+												h_flip_tile_avx2 });
+#endif
+	return kernels;
+}
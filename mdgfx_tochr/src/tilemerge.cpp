@@ -0,0 +1,325 @@
+#include "tilemerge.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+constexpr size_t NO_CHR { numeric_limits<size_t>::max() };
+
+// number of pixels that differ between two tiles
+size_t tile_distance(PackedChr const & a, PackedChr const & b)
+{
+	size_t distance { 0 };
+	for(size_t this_row { 0 }; this_row < 8; ++this_row)
+	{
+		// fold each differing pixel down to the low bit of its nibble, then add
+		// up the nibbles
+		u32 diff { a.rows[this_row] ^ b.rows[this_row] };
+		diff = (diff | (diff >> 1) | (diff >> 2) | (diff >> 3)) & 0x11111111;
+		distance += (diff * 0x11111111) >> 28;
+	}
+	return distance;
+}
+
+// flip bit 0 is horizontal, bit 1 vertical
+void flip_tile(PackedChr & chr, u8 const flip)
+{
+	if(flip & 1)
+		h_flip_tile(chr);
+	if(flip & 2)
+		v_flip_tile(chr);
+}
+
+// the closest tile to another, and the flips which take the other tile
+// closest to it
+struct Neighbour
+{
+	size_t chr;
+	size_t distance;
+	u8 flip;
+};
+
+/**
+ * Vantage point tree over a set of tiles, for finding the closest to a given
+ * tile without comparing it to all of them
+ * Each node splits the tiles below it into those within its radius of the node
+ * tile and those further out, so whole branches can be skipped when they're
+ * too far away to hold anything closer than what's been found
+ */
+class TileIndex
+{
+public:
+	TileIndex(vector<PackedChr> const & chrs) :
+			m_chrs(chrs), m_removed(chrs.size(), false)
+	{
+		vector<size_t> order(chrs.size());
+		iota(order.begin(), order.end(), 0);
+		m_nodes.reserve(chrs.size());
+		m_root = build(order.begin(), order.end());
+	}
+
+	/**
+	 * Takes a tile out of the results (it's still used to find the others)
+	 */
+	void remove(size_t const chr)
+	{
+		m_removed[chr] = true;
+	}
+
+	/**
+	 * The closest tile to chr (besides itself and those in skip) under any flip,
+	 * if there is one no more than max_distance pixels away
+	 */
+	optional<Neighbour> nearest(size_t const chr, size_t const max_distance,
+															vector<size_t> const & skip) const
+	{
+		Neighbour best { NO_CHR, max_distance, 0 };
+		for(u8 flip { 0 }; flip < 4; ++flip)
+		{
+			PackedChr query { m_chrs[chr] };
+			flip_tile(query, flip);
+			search(m_root, query, chr, flip, skip, best);
+		}
+		if(best.chr == NO_CHR)
+			return nullopt;
+		return best;
+	}
+
+private:
+	struct Node
+	{
+		size_t chr;
+		size_t radius;
+		size_t inside;
+		size_t outside;
+	};
+
+	size_t build(vector<size_t>::iterator first, vector<size_t>::iterator last)
+	{
+		if(first == last)
+			return NO_CHR;
+
+		// the first tile is the vantage point, the rest are split around the
+		// median of their distances to it
+		size_t const node_idx { m_nodes.size() };
+		m_nodes.push_back(Node { *first, 0, NO_CHR, NO_CHR });
+		PackedChr const & vantage { m_chrs[*first] };
+		++first;
+		if(first == last)
+			return node_idx;
+
+		auto const middle { first + (last - first) / 2 };
+		nth_element(first, middle, last, [&](size_t a, size_t b) {
+			size_t const distance_a { tile_distance(vantage, m_chrs[a]) },
+					distance_b { tile_distance(vantage, m_chrs[b]) };
+			return distance_a != distance_b ? distance_a < distance_b : a < b;
+		});
+		m_nodes[node_idx].radius = tile_distance(vantage, m_chrs[*middle]);
+
+		size_t const inside { build(first, middle) };
+		size_t const outside { build(middle, last) };
+		m_nodes[node_idx].inside = inside;
+		m_nodes[node_idx].outside = outside;
+		return node_idx;
+	}
+
+	void search(size_t const node_idx, PackedChr const & query, size_t const chr,
+							u8 const flip, vector<size_t> const & skip,
+							Neighbour & best) const
+	{
+		if(node_idx == NO_CHR)
+			return;
+
+		auto const & node { m_nodes[node_idx] };
+		size_t const distance { tile_distance(query, m_chrs[node.chr]) };
+		if(node.chr != chr && !m_removed[node.chr] &&
+			 (distance < best.distance ||
+				(distance == best.distance && node.chr < best.chr)) &&
+			 find(skip.begin(), skip.end(), node.chr) == skip.end())
+			best = Neighbour { node.chr, distance, flip };
+
+		// (the tiles inside are no further than the radius, the tiles outside no
+		// closer)
+		if(distance <= node.radius + best.distance)
+			search(node.inside, query, chr, flip, skip, best);
+		if(distance + best.distance >= node.radius)
+			search(node.outside, query, chr, flip, skip, best);
+	}
+
+	vector<PackedChr> const & m_chrs;
+	vector<bool> m_removed;
+	vector<Node> m_nodes;
+	size_t m_root;
+};
+
+// a tile that could be merged into another
+struct MergeCandidate
+{
+	size_t distance;
+	size_t chr;
+	size_t into;
+	u8 flip;
+
+	// closest first, then in tile order
+	bool operator>(MergeCandidate const & other) const
+	{
+		return distance != other.distance ? distance > other.distance
+																			: chr > other.chr;
+	}
+};
+
+} // namespace
+
+void merge_near_duplicates(TileAnalysis & analysis, size_t const max_tiles,
+													 size_t const tolerance)
+{
+	auto const & chrs { analysis.chrs };
+	size_t const count { chrs.size() };
+	if(max_tiles > 0 && count <= max_tiles)
+		return;
+
+	// number of map entries using each tile
+	vector<size_t> uses(count, 0);
+	for(auto const & info : analysis.infolist)
+		if(info.type != BLANK)
+			++uses[info.idx_opt];
+
+	// the tile each one has been merged into (itself if it's still in), and the
+	// flips to match it
+	vector<size_t> merged_into(count);
+	iota(merged_into.begin(), merged_into.end(), 0);
+	vector<u8> merge_flip(count, 0);
+	// the tiles standing in for each other (with the flips to match it), and
+	// the tiles each has been found not to fit into
+	vector<vector<pair<size_t, u8>>> members(count);
+	vector<vector<size_t>> rejected(count);
+	for(size_t this_chr { 0 }; this_chr < count; ++this_chr)
+		members[this_chr].emplace_back(this_chr, 0);
+
+	TileIndex index { chrs };
+	priority_queue<MergeCandidate, vector<MergeCandidate>,
+								 greater<MergeCandidate>>
+			candidates;
+	auto find_candidate = [&](size_t chr) {
+		auto const neighbour { index.nearest(chr, tolerance, rejected[chr]) };
+		if(neighbour.has_value())
+			candidates.push(MergeCandidate { neighbour->distance, chr,
+																			 neighbour->chr, neighbour->flip });
+	};
+
+	// a tile can only be merged along with all the tiles it stands in for, so
+	// every original tile stays within the tolerance of the one replacing it
+	auto fits = [&](size_t from, size_t into, u8 flip) {
+		for(auto const & member : members[from])
+		{
+			PackedChr chr { chrs[member.first] };
+			flip_tile(chr, member.second ^ flip);
+			if(tile_distance(chr, chrs[into]) > tolerance)
+				return false;
+		}
+		return true;
+	};
+
+	for(size_t this_chr { 0 }; this_chr < count; ++this_chr)
+		find_candidate(this_chr);
+
+	size_t remaining { count };
+	while((max_tiles == 0 || remaining > max_tiles) && !candidates.empty())
+	{
+		auto const candidate { candidates.top() };
+		candidates.pop();
+
+		if(merged_into[candidate.chr] != candidate.chr)
+			continue;
+		// the closest tile has since been merged away, so look again
+		if(merged_into[candidate.into] != candidate.into)
+		{
+			find_candidate(candidate.chr);
+			continue;
+		}
+
+		// the tile used more often is kept if it can be, and the flips work the
+		// same either way round
+		size_t from { candidate.chr }, into { candidate.into };
+		if(uses[from] > uses[into])
+			swap(from, into);
+		if(!fits(from, into, candidate.flip))
+		{
+			swap(from, into);
+			if(!fits(from, into, candidate.flip))
+			{
+				rejected[candidate.chr].push_back(candidate.into);
+				find_candidate(candidate.chr);
+				continue;
+			}
+		}
+
+		for(auto const & member : members[from])
+		{
+			merged_into[member.first] = into;
+			merge_flip[member.first] = member.second ^ candidate.flip;
+			members[into].emplace_back(member.first, member.second ^ candidate.flip);
+		}
+		members[from].clear();
+		uses[into] += uses[from];
+		index.remove(from);
+		--remaining;
+
+		// and the merged tile may have somewhere to go itself
+		find_candidate(into);
+	}
+
+	if(max_tiles > 0 && remaining > max_tiles)
+		throw runtime_error("Could not merge tiles down to " +
+												to_string(max_tiles) + " within a tolerance of " +
+												to_string(tolerance) + " pixels (" +
+												to_string(remaining) + " left)");
+
+	// the tiles that are left keep their order
+	vector<u32> new_idx(count);
+	vector<PackedChr> kept;
+	kept.reserve(remaining);
+	for(size_t this_chr { 0 }; this_chr < count; ++this_chr)
+	{
+		if(merged_into[this_chr] != this_chr)
+			continue;
+		new_idx[this_chr] = kept.size();
+		kept.push_back(chrs[this_chr]);
+	}
+
+	// the map entry which owns each tile, for the new dupes to point to
+	vector<size_t> owners(count, NO_CHR);
+	for(size_t this_info { 0 }; this_info < analysis.infolist.size();
+			++this_info)
+	{
+		auto const & info { analysis.infolist[this_info] };
+		if(info.type != BLANK && !info.dupe_of_idx)
+			owners[info.idx_opt] = this_info;
+	}
+
+	for(auto & info : analysis.infolist)
+	{
+		if(info.type == BLANK)
+			continue;
+		size_t const chr { info.idx_opt };
+		size_t const into { merged_into[chr] };
+		if(into != chr)
+		{
+			// the entry showed the old tile with its flips; the old tile is
+			// closest to the new one with the merge flips, so both are combined
+			info.h_flip = info.h_flip != ((merge_flip[chr] & 1) != 0);
+			info.v_flip = info.v_flip != ((merge_flip[chr] & 2) != 0);
+			info.dupe_of_idx = owners[into];
+		}
+		info.idx_opt = new_idx[into];
+	}
+
+	analysis.chrs = move(kept);
+}
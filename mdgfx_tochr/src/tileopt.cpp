@@ -1,5 +1,6 @@
 
 #include "tileopt.hpp"
+#include "workpool.hpp"
 
 using namespace std;
 using namespace chrgfx;
@@ -9,233 +10,211 @@ TilemapEntry::TilemapEntry() :
 
 TileOptInfo::TileOptInfo() :
 		type(TileType::UNDEFINED), idx(0), idx_opt(0), dupe_of_idx(nullopt),
-		flat_palidx(0), v_flip(false), h_flip(false), crc(0), crc_v_flip(0),
-		crc_h_flip(0), crc_hv_flip(0), tile_data(nullptr) {};
+		flat_palidx(0), v_flip(false), h_flip(false), crc(0), canon_v_flip(false),
+		canon_h_flip(false) {};
+
+TileAnalyzer::TileAnalyzer(size_t const start_chr) : m_start_chr(start_chr) {};
 
 /**
- * generates a list of TileOptInfo objects, one for each tile, which
- * will be used to optimize chr data inclusion in the graphics data and specify
- * tile references in the map data
+ * classifies a single tile and checks it against the unique tiles seen so far
+ * (this covers what used to be pass 1 and pass 2 of analyze(), done one tile
+ * at a time so the source image doesn't need to be fully in memory)
  */
-vector<TileOptInfo> analyze(buffer<byte_t> const & basic_tiles,
-														size_t const start_chr, size_t const chr_count)
+void TileAnalyzer::add(PackedChr const & chr)
 {
 	// allocate some space for flipping a test tile around
-	byte_t flip_buffer[BASIC_CHR_BYTESZ];
+	PackedChr flip_buffer;
+	PackedChr canon_buffer;
+
+	TileOptInfo tileinfo;
+	tileinfo.idx = m_start_chr + m_infolist.size();
+
+	// **************** PASS 1
+	// identify flat & blank tiles and generate CRCs for normal tiles
 
-	vector<TileOptInfo> out_infolist;
-	out_infolist.reserve(chr_count);
+	// we do not treat blanks as flats for two reasons
+	// 	one, it is likely that chr 0 in VRAM is already blank, so there's no
+	// 		reason to waste an extra tile when we can reference that one
+	//	two, we can assume a blank tile is "non-existant" in terms
+	//		of our output map, which will help to optimize maps with lots of
+	//		blank space
 
-	size_t this_orig_idx { 0 };
+	// TODO: we don't know that vram chr 0 is always blank, so add a flag that
+	// treat blanks as flats and include in chr
 
-	// pass 1 - identify flat & blank tiles and generate CRCs for normal tiles
-	auto iter_chr = basic_tiles.begin<byte_t[BASIC_CHR_BYTESZ]>() + start_chr;
-	auto iter_end = iter_chr + chr_count;
-	while(iter_chr != iter_end)
+	// check if tile is flat (all one color)
+	if(is_flat_tile(chr))
 	{
-		auto this_chr = *iter_chr;
-		TileOptInfo tileinfo;
-		tileinfo.tile_data = this_chr;
-		tileinfo.idx = this_orig_idx++;
-
-		// we do not treat blanks as flats for two reasons
-		// 	one, it is likely that chr 0 in VRAM is already blank, so there's no
-		// 		reason to waste an extra tile when we can reference that one
-		//	two, we can assume a blank tile is "non-existant" in terms
-		//		of our output map, which will help to optimize maps with lots of
-		//		blank space
-
-		// TODO: we don't know that vram chr 0 is always blank, so add a flag that
-		// treat blanks as flats and include in chr
-
-		// check if tile is flat (all one color)
-		if(is_flat_tile(this_chr))
+		// check if the flat color is palette entry 0
+		// i.e. if the tile is blank
+		if(is_blank_tile(chr))
 		{
-			// check if the flat color is palette entry 0
-			// i.e. if the tile is blank
-			if(this_chr[0] == 0)
-			{
-				tileinfo.type = BLANK;
-			}
-			else
-			{
-				tileinfo.type = FLAT;
-				tileinfo.flat_palidx = this_chr[0];
-			}
-			// don't need to bother with CRCs if it's a flat
-			goto end_checks;
+			tileinfo.type = BLANK;
 		}
-
+		else
+		{
+			tileinfo.type = FLAT;
+			tileinfo.flat_palidx = chr.rows[0] & 0xf;
+		}
+		// don't need to bother with CRCs if it's a flat
+	}
+	else
+	{
 		// neither blank nor flat, must be normal
 		tileinfo.type = NORMAL;
 
-		// get CRC for tile in all positions
-		// crc for normal
-		tileinfo.crc = crc32(0, (Bytef *)this_chr, BASIC_CHR_BYTESZ);
-
-		// crc for hflip
-		copy(this_chr, this_chr + BASIC_CHR_BYTESZ, flip_buffer);
-		h_flip_tile(flip_buffer);
-		tileinfo.crc_h_flip = crc32(0, (Bytef *)flip_buffer, BASIC_CHR_BYTESZ);
-
-		// crc for vflip
-		copy(this_chr, this_chr + BASIC_CHR_BYTESZ, flip_buffer);
-		v_flip_tile(flip_buffer);
-		tileinfo.crc_v_flip = crc32(0, (Bytef *)flip_buffer, BASIC_CHR_BYTESZ);
-
-		// crc for hvflip
-		copy(this_chr, this_chr + BASIC_CHR_BYTESZ, flip_buffer);
-		h_flip_tile(flip_buffer);
-		v_flip_tile(flip_buffer);
-		tileinfo.crc_hv_flip = crc32(0, (Bytef *)flip_buffer, BASIC_CHR_BYTESZ);
-
-	end_checks:
-		out_infolist.push_back(tileinfo);
-		++iter_chr;
+		// find the canonical orientation of the tile, which is the flip variation
+		// that sorts lowest row-wise (ties go to the first of normal, h, v, hv)
+		// all flipped copies of a tile share the same canonical data, so a single
+		// CRC of that is enough to find them in pass 2
+		canon_buffer = chr;
+		for(u8 flip { 1 }; flip < 4; ++flip)
+		{
+			flip_buffer = chr;
+			if(flip & 1)
+				h_flip_tile(flip_buffer);
+			if(flip & 2)
+				v_flip_tile(flip_buffer);
+			if(lexicographical_compare(begin(flip_buffer.rows), end(flip_buffer.rows),
+																 begin(canon_buffer.rows),
+																 end(canon_buffer.rows)))
+			{
+				canon_buffer = flip_buffer;
+				tileinfo.canon_h_flip = flip & 1;
+				tileinfo.canon_v_flip = flip & 2;
+			}
+		}
+		tileinfo.crc = crc32(0, (Bytef *)canon_buffer.rows, PACKED_CHR_BYTESZ);
 	}
 
+	append(tileinfo, chr);
+}
+
+void TileAnalyzer::append(TileOptInfo tileinfo, PackedChr const & chr)
+{
+	// allocate some space for flipping a test tile around
+	PackedChr flip_buffer;
+
 	// **************** PASS 2
 	// identify duplicate tiles
-	// 	- out loop through each tile backwards from end (the work tile)
-	// 	- inner loop through each tile forwards from start (the compare tile)
-	// 	- compare each CRC variation of the work tile to only the NORMAL CRC of
-	// 		the compare tile
-	// 	- if there is a match, do a deep compare to ensure the match is valid
-	// 		and not a CRC collision
+	// 	- keep an index of the "master" tiles seen so far (the first occurrence
+	//		of each unique tile), along with a copy of their data
+	// 	- flats are indexed by their color, normals by their canonical CRC
+	// 	- look up the canonical CRC of the work tile in the master index
+	// 	- if there is a hit, the flips needed to match the master are the
+	//		canonical flips of the two tiles combined; do a deep compare with
+	//		those flips applied to ensure the match is not a CRC collision
 	// 	- if a true match, mark the work tile as duplicate, point it to the
-	//		compare tile as the original/"master" and set flip flags as
-	//		necessary so it would match the master tile
-
-	// loop backwards from back (work tiles)
-	for(auto work_tile { out_infolist.rbegin() };
-			work_tile != out_infolist.rend(); ++work_tile)
+	//		master and set flip flags as necessary so it would match the master
+	// 	- otherwise, the work tile becomes a master itself
+	// this gives the same result as comparing each tile against every tile
+	// before it, since the first earlier tile to match is always the master,
+	// but needs only a single lookup per tile instead of a full scan
+	// (for symmetrical tiles, the combined flips also work out to the first
+	// match in normal, h, v, hv order, as before)
+	size_t const work_tile_idx { m_infolist.size() };
+
+	// if our current tile is flat, check only against other flats
+	if(tileinfo.type == FLAT)
 	{
-		// all tiles should have been given a type in the previous pass
-		if(work_tile->type == UNDEFINED)
-			throw runtime_error(
-					"Found tile marked UNDEFINED in pass 2 of tile info generation");
-
-		// always ignore blank tiles since there's nothing inside to compare
-		if(work_tile->type == BLANK)
-			continue;
-
-		// loop forwards from start (compare tiles)
-		size_t compare_tile_idx { 0 };
-		for(auto compare_tile { out_infolist.begin() };
-				compare_tile != out_infolist.end(); ++compare_tile, ++compare_tile_idx)
+		auto i_master { m_flat_masters.find(tileinfo.flat_palidx) };
+		if(i_master == m_flat_masters.end())
+			m_flat_masters.emplace(tileinfo.flat_palidx, work_tile_idx);
+		else
+			// we have a dupe!
+			tileinfo.dupe_of_idx = i_master->second;
+	}
+	else if(tileinfo.type == NORMAL)
+	{
+		auto range { m_normal_masters.equal_range(tileinfo.crc) };
+		for(auto i_master { range.first }; i_master != range.second; ++i_master)
 		{
-			// tile to compare against is blank? move along
-			if(compare_tile->type == BLANK)
-				continue;
-
-			// working on the same tile? move along
-			// TODO: if we've reached the current tile going forward, do we
-			// even need to continue? presumably tiles *after* the current work
-			// tile have already been checked anyway since the outer loop
-			// goes backwards...
-			// -- per above, we break here insted
-			// it seems to work fine, but if there's some weirdness check here first
-			// **************************
-			// SOMETHING BROKEN? CHeck here first
-			// **************************
-			if(&(*work_tile) == &(*compare_tile))
+			size_t const master_idx { m_chr_owners[i_master->second] };
+			auto const & master { m_infolist[master_idx] };
+			bool const h_flip { tileinfo.canon_h_flip != master.canon_h_flip };
+			bool const v_flip { tileinfo.canon_v_flip != master.canon_v_flip };
+
+			// we (might) have a dupe!
+			// do deep compare to be sure there wasn't a CRC collision
+			flip_buffer = chr;
+			if(h_flip)
+				h_flip_tile(flip_buffer);
+			if(v_flip)
+				v_flip_tile(flip_buffer);
+			if(is_identical_tile(flip_buffer, m_chrs[i_master->second]))
 			{
-				// continue;
+				// we have a dupe!
+				tileinfo.dupe_of_idx = master_idx;
+				tileinfo.h_flip = h_flip;
+				tileinfo.v_flip = v_flip;
 				break;
 			}
+		}
 
-			//	- if the compare tile already marked as duplicate of another tile
-			//		elsewhere, move along
-			//	- we only want to reference the "master" tile of any dupes
-			if(compare_tile->dupe_of_idx)
-				continue;
-
-			// if our current tile is flat, check only against other flats
-			if(work_tile->type == FLAT)
-			{
-				// if both tiles are flat, see if they share the same color
-				if(compare_tile->type == FLAT &&
-					 work_tile->flat_palidx == compare_tile->flat_palidx)
-				{
-					// we have a dupe!
-					work_tile->dupe_of_idx = compare_tile_idx;
-					// exit our dupe check loop
-					break;
-				}
-				// ignore if the compare tile is not also flat
-				continue;
-			}
+		// no dupes, this is the first occurrence of the tile
+		if(!tileinfo.dupe_of_idx)
+			m_normal_masters.emplace(tileinfo.crc, m_chrs.size());
+	}
 
-			// compare normal tile
-			if(work_tile->crc == compare_tile->crc)
-			{
-				// we (might) have a dupe!
-				// do deep compare to be sure there wasn't a CRC collision
-				if(is_identical_tile(work_tile->tile_data, compare_tile->tile_data))
-				{
-					// we have a dupe!
-					work_tile->dupe_of_idx = compare_tile_idx;
-					// break out of the loop, since we've found a dupe
-					// (presumably, the first one since our compare loop moves forward)
-					break;
-				}
-			}
+	// always ignore blank tiles since there's nothing inside to compare
+	// everything else that isn't a dupe is kept for the final output
+	if(tileinfo.type != BLANK && !tileinfo.dupe_of_idx)
+	{
+		m_chrs.push_back(chr);
+		m_chr_owners.push_back(work_tile_idx);
+	}
 
-			// compare against hflip tile
-			if(work_tile->crc_h_flip == compare_tile->crc)
-			{
-				// we (might) have a dupe!
-				copy(work_tile->tile_data, work_tile->tile_data + BASIC_CHR_BYTESZ,
-						 flip_buffer);
-				h_flip_tile(flip_buffer);
-				if(is_identical_tile(flip_buffer, compare_tile->tile_data))
-				{
-					// we have a dupe!
-					work_tile->dupe_of_idx = compare_tile_idx;
-					work_tile->h_flip = true;
-					break;
-				}
-			}
+	m_infolist.push_back(tileinfo);
+}
 
-			// compare against vflip tile
-			if(work_tile->crc_v_flip == compare_tile->crc)
-			{
-				// we (might) have a dupe!
-				copy(work_tile->tile_data, work_tile->tile_data + BASIC_CHR_BYTESZ,
-						 flip_buffer);
-				v_flip_tile(flip_buffer);
-				if(is_identical_tile(flip_buffer, compare_tile->tile_data))
-				{
-					// we have a dupe!
-					work_tile->dupe_of_idx = compare_tile_idx;
-					work_tile->v_flip = true;
-					break;
-				}
-			}
+void TileAnalyzer::merge(TileAnalyzer const & other)
+{
+	// the other analyzer's tiles come right after ours in the source image
+	// 	- its master tiles go through the same dedup as newly added tiles, in
+	//		order, so the first occurrence of a tile across both stays the master
+	// 	- its duplicates then point to wherever their own master ended up
+	// so the result is identical to adding all the tiles to one analyzer
+	size_t const offset { m_infolist.size() };
+	auto i_chr { other.m_chrs.begin() };
+
+	for(auto tileinfo : other.m_infolist)
+	{
+		if(tileinfo.type == BLANK)
+		{
+			m_infolist.push_back(tileinfo);
+			continue;
+		}
 
-			// compare against hvflip tile
-			if(work_tile->crc_hv_flip == compare_tile->crc)
-			{
-				// we (might) have a dupe!
-				copy(work_tile->tile_data, work_tile->tile_data + BASIC_CHR_BYTESZ,
-						 flip_buffer);
-				h_flip_tile(flip_buffer);
-				v_flip_tile(flip_buffer);
-				if(is_identical_tile(flip_buffer, compare_tile->tile_data))
-				{
-					// we have a dupe!
-					work_tile->dupe_of_idx = compare_tile_idx;
-					work_tile->h_flip = true;
-					work_tile->v_flip = true;
-					break;
-				}
-			}
+		if(!tileinfo.dupe_of_idx)
+		{
+			append(tileinfo, *i_chr++);
+			continue;
 		}
 
-		// if we reached this part of the loop, there have been no dupes
-		// keep on movin'
+		auto const & local_master { m_infolist[offset + *tileinfo.dupe_of_idx] };
+		size_t const master_idx { local_master.dupe_of_idx
+																	? *local_master.dupe_of_idx
+																	: offset + *tileinfo.dupe_of_idx };
+		auto const & master { m_infolist[master_idx] };
+		tileinfo.dupe_of_idx = master_idx;
+		tileinfo.h_flip = tileinfo.canon_h_flip != master.canon_h_flip;
+		tileinfo.v_flip = tileinfo.canon_v_flip != master.canon_v_flip;
+		m_infolist.push_back(tileinfo);
 	}
+}
+
+size_t TileAnalyzer::size() const
+{
+	return m_infolist.size();
+}
 
+size_t TileAnalyzer::start_chr() const
+{
+	return m_start_chr;
+}
+
+void TileAnalyzer::finish()
+{
 	// **************** PASS 3
 	// 	- at this point, all tiles should have been evaluated for duplicates
 	// 	- now assign a final order to all unique tiles
@@ -245,110 +224,88 @@ vector<TileOptInfo> analyze(buffer<byte_t> const & basic_tiles,
 
 	// put flats at the front
 	// (no particular reason for this, just makes things "cleaner", imo)
-	for(auto & this_tile : out_infolist)
+	for(auto & this_tile : m_infolist)
 		if((this_tile.type == FLAT) & !this_tile.dupe_of_idx)
 			this_tile.idx_opt = optimized_idx++;
 
 	// put the rest of the unique
-	for(auto & this_tile : out_infolist)
+	for(auto & this_tile : m_infolist)
 		if(this_tile.type == NORMAL && !this_tile.dupe_of_idx)
 			this_tile.idx_opt = optimized_idx++;
 
 	// all unique tiles now have a final index assigned
 	// now point all duplicated tiles to the final, optimized index of the
 	// tile that they duplicate
-	for(auto & this_tile : out_infolist)
+	for(auto & this_tile : m_infolist)
 		if(this_tile.dupe_of_idx)
-			this_tile.idx_opt = out_infolist[this_tile.dupe_of_idx.value()].idx_opt;
+			this_tile.idx_opt = m_infolist[this_tile.dupe_of_idx.value()].idx_opt;
+}
 
-	return out_infolist;
+vector<TileOptInfo> const & TileAnalyzer::infolist() const
+{
+	return m_infolist;
 }
 
 /**
- * Create a list of pointers to the unique, "master" tiles to be
- * exported as the final collection of CHR graphics for use
+ * The unique, "master" tiles to be exported as the final collection of
+ * CHR graphics for use, in optimized index order
  */
-vector<byte_t *> filter_chrs(vector<TileOptInfo> const & infolist)
+vector<PackedChr> TileAnalyzer::filter_chrs() const
 {
-	size_t unique_tile_count { 0 };
-
-	// not the most efficient way to do things but eh...
-	for(auto const & this_tile : infolist)
-	{
-		// find the tile with the highest optimized index and use that as
-		// the final tile count...
-		if(this_tile.idx_opt > unique_tile_count)
-			unique_tile_count = this_tile.idx_opt;
-	}
-	// ... plus one, because idxOpt is a 0 based index
-	++unique_tile_count;
-
-	vector<byte_t *> unique_chrs(unique_tile_count, nullptr);
-
-	for(auto const & tileinfo : infolist)
-	{
-		if(tileinfo.type == BLANK)
-			continue;
-		if(unique_chrs[tileinfo.idx_opt] == nullptr)
-			unique_chrs[tileinfo.idx_opt] = tileinfo.tile_data;
-	}
-
+	vector<PackedChr> unique_chrs(m_chrs.size());
+	for(size_t this_chr { 0 }; this_chr < m_chrs.size(); ++this_chr)
+		unique_chrs[m_infolist[m_chr_owners[this_chr]].idx_opt] = m_chrs[this_chr];
 	return unique_chrs;
 }
 
-u16 make_chirari_rle_entry(TileOptInfo info, u16 tile_base = 0, u8 tile_run = 1)
+TileAnalysis TileAnalyzer::result() const
 {
-	// tilemap format:
-	// |   | | |           |
-	//  xxx v h ttttttttttt
-	// t - tile id
-	// v, h - flip bits
-	// xxx - empty/run length
-
-	// for xxx, if only low bit is set, indicates this is a run of blank tiles
-	// all lower bits (0 to 12) will be used for the run length of blank tiles
-	// if any other xxx bits are set, all lower bits are as normal, and the xxx
-	// bits count as the run length
-
-	if(tile_run < 1)
-		throw out_of_range("Tile run must be positive value");
-
-	u16 outMapEntry { 0 };
-
-	if(info.type == BLANK)
-	{
-		// if it's a single blank tile, don't mess with RLE
-		// if (tileRun == 1)
-		//	return 0;
-		// ACKCHUALLY...
-		// we need "single runs" to identify blanks from actual entries
-		// with tile index 0...
-		// this was a design oversight and we could probably make things more
-		// elegant but for now run of 1 for blanks is valid
-
-		// set the blank tile run flag (lowest bit of RLE bitfield)
-		outMapEntry = 0x2000;
-		outMapEntry |= (tile_run & 0x1fff);
-		return outMapEntry;
-	}
-
-	// make sure the tile id is within VRAM range
-	outMapEntry = ((tile_base + info.idx_opt) & 0x7ff);
-
-	if(tile_run > 1)
-	{
-		// make sure the tile run is within RLE range
-		tile_run &= 0x7;
-		outMapEntry |= (tile_run << 13);
-	}
+	return TileAnalysis { m_infolist, filter_chrs() };
+}
 
-	// apply flip flags
-	if(info.h_flip)
-		outMapEntry |= 0x800;
-	if(info.v_flip)
-		outMapEntry |= 0x1000;
+TileAnalyzer make_analyzer(TileView const & tiles, size_t const start_chr,
+													size_t const chr_count, size_t const threads)
+{
+	// split the tiles into one contiguous shard per thread (but don't bother
+	// with tiny shards) and analyze each on its own, then merge them in order
+	// merging keeps the earliest tile as the master, so the results are the
+	// same no matter how many threads are used
+	size_t const shard_count { max<size_t>(
+			1, min(threads, chr_count / MIN_SHARD_SIZE)) };
+
+	// tiles are read straight out of the image; only the unique ones are copied
+	vector<TileAnalyzer> shards;
+	shards.reserve(shard_count);
+	for(size_t this_shard { 0 }; this_shard < shard_count; ++this_shard)
+		shards.emplace_back(start_chr + (chr_count * this_shard / shard_count));
+
+	parallel_for(shard_count, shard_count, [&](size_t this_shard) {
+		size_t const shard_end { start_chr +
+														 (chr_count * (this_shard + 1) / shard_count) };
+		auto & analyzer { shards[this_shard] };
+		for(size_t this_chr { analyzer.start_chr() }; this_chr < shard_end;
+				++this_chr)
+			analyzer.add(tiles.get_packed(this_chr));
+	});
+
+	auto & analyzer { shards.front() };
+	for(size_t this_shard { 1 }; this_shard < shard_count; ++this_shard)
+		analyzer.merge(shards[this_shard]);
+
+	return move(analyzer);
+}
 
-	return outMapEntry;
+/**
+ * generates a list of TileOptInfo objects, one for each tile, which
+ * will be used to optimize chr data inclusion in the graphics data and specify
+ * tile references in the map data, along with the unique tiles themselves
+ */
+TileAnalysis analyze(TileView const & tiles, size_t const start_chr,
+										 size_t const chr_count, size_t const threads)
+{
+	auto analyzer { make_analyzer(tiles, start_chr, chr_count, threads) };
+	analyzer.finish();
+	return analyzer.result();
 }
 
 vector<u16> make_optinfo_tilemap(vector<TileOptInfo> const & infolist,
@@ -362,7 +319,7 @@ vector<u16> make_optinfo_tilemap(vector<TileOptInfo> const & infolist,
 	for(size_t i { index }; i < (index + length); ++i)
 	{
 		TileOptInfo info = infolist[i];
-		u16 tileidx = info.type == BLANK ? 0 : info.idx_opt + tile_base;
+		u32 tileidx = info.type == BLANK ? 0 : info.idx_opt + tile_base;
 		out_map.push_back(make_nametable_entry(tileidx, pal_line, priority,
 																					 info.h_flip, info.v_flip));
 	}
@@ -370,86 +327,162 @@ vector<u16> make_optinfo_tilemap(vector<TileOptInfo> const & infolist,
 	return out_map;
 }
 
-// TODO this is still using that temp style with iterators, fix it up
-vector<u16> make_rle_tilemap(vector<TileOptInfo> const & infolist,
-														 size_t const index, size_t const length,
-														 size_t const tilemap_width, u16 const tile_base)
+namespace
 {
+// Chirari RLE tilemap format:
+// a word with the map width in tiles, then one word per entry, then 0xffff
+// |   | | |           |
+//  xxx v h ttttttttttt
+// t - tile id
+// v, h - flip bits
+// xxx - empty/run length
+// if xxx is only the low bit, the entry is a run of blank tiles and all the
+// lower bits (0 to 12) are the run length
+// otherwise, the tile bits are as normal and xxx is the number of times the
+// entry is repeated (0 for a single tile, as 1 would mean blank)
+// blanks are always marked as a run, even a run of one, since otherwise they'd
+// look like tile 0
+constexpr u16 RLE_BLANK_RUN { 0x2000 };
+constexpr u16 RLE_ENTRY_MASK { 0x1fff };
+constexpr u8 RLE_RUN_SHIFT { 13 };
+constexpr size_t RLE_MAX_TILE_RUN { 7 };
+constexpr size_t RLE_MAX_BLANK_RUN { 0x1fff };
+
+// the tile id and flip bits of a (non-blank) entry
+u16 make_rle_tile(TileOptInfo const & info, u16 const tile_base)
+{
+	u16 entry = (tile_base + info.idx_opt) & 0x7ff;
+	if(info.h_flip)
+		entry |= 0x800;
+	if(info.v_flip)
+		entry |= 0x1000;
+	return entry;
+}
 
-	vector<u16> outTilemap;
-
-	outTilemap.reserve(length + 2);
-	outTilemap.push_back(tilemap_width);
-
-	size_t runlength { 1 };
+#ifdef DEBUG
+// makes sure the encoded map decodes back to the tiles it was made from
+void check_rle_tilemap(vector<u16> const & tilemap,
+											 vector<TileOptInfo> const & infolist,
+											 size_t const index, size_t const length,
+											 u16 const tile_base)
+{
+	auto const decoded { decode_rle_tilemap(tilemap) };
 
-	auto this_info { infolist.begin() + index };
-	auto info_end { this_info + length };
-	auto info_prev = this_info;
+	size_t this_chr { index };
+	for(auto const & entry : decoded.entries)
+	{
+		size_t const runlength { entry.runlength.value_or(1) };
+		for(size_t this_run { 0 }; this_run < runlength; ++this_run, ++this_chr)
+		{
+			if(this_chr == index + length)
+				throw runtime_error("RLE tilemap decodes to too many tiles");
+			auto const & info { infolist[this_chr] };
+			bool const matches {
+				info.type == BLANK
+						? !entry.id
+						: entry.id && *entry.id == ((tile_base + info.idx_opt) & 0x7ff) &&
+									entry.h_flip == info.h_flip && entry.v_flip == info.v_flip
+			};
+			if(!matches)
+				throw runtime_error("RLE tilemap does not match source at tile " +
+														to_string(this_chr - index));
+		}
+	}
+	if(this_chr != index + length)
+		throw runtime_error("RLE tilemap decodes to too few tiles");
+}
+#endif
+} // namespace
 
-	// begin comparison at the second tile
-	++this_info;
+vector<u16> make_rle_tilemap(vector<TileOptInfo> const & infolist,
+														 size_t const index, size_t const length,
+														 size_t const tilemap_width, u16 const tile_base)
+{
+	vector<u16> tilemap;
+	tilemap.reserve(length + 2);
+	tilemap.push_back(tilemap_width);
 
-	int counter = 0;
-	do
+	size_t const end { index + length };
+	size_t this_chr { index };
+	while(this_chr < end)
 	{
-		++counter;
-		// if this tile and the previous were empty, add to run
-		if((this_info->type == BLANK) && (info_prev->type == BLANK))
+		auto const & info { infolist[this_chr] };
+		size_t runlength { 1 };
+
+		if(info.type == BLANK)
 		{
-			++runlength;
-			++info_prev;
-			continue;
+			while(this_chr + runlength < end &&
+						infolist[this_chr + runlength].type == BLANK &&
+						runlength < RLE_MAX_BLANK_RUN)
+				++runlength;
+			tilemap.push_back(RLE_BLANK_RUN | runlength);
 		}
-
-		// if we're here, we're dealing with a flat or normal tile
-		// check if the tile ID, hflip and vflip are all identical
-		if((this_info->idx_opt == info_prev->idx_opt) &&
-			 (this_info->h_flip == info_prev->h_flip) &&
-			 (this_info->v_flip == info_prev->v_flip) && (info_prev->type != BLANK) &&
-			 (this_info->type != BLANK))
+		else
 		{
-			++runlength;
-			// max run of 7 due to only have 3 bits to work with
-			if(runlength < 7)
-			{
-				// our run is not yet maxxed, check the next tile
-				continue;
-			}
-			// we've hit a full run, stop and process it
-
-			// (it's important to skip over the current tile for the next check
-			// otherwise it will cause issues for long runs (runs over 7)
-			// this is because this_tile is being included as the end of a run now
-			// and if we do not skip over it, it will be marked as prev_tile in the
-			// next iteration, recognized as part of a run, and included as part
-			// of the next run as well, throwing things further and further off
-			// with the length of the run)
-			// (this was a bug that gave me quite a headache)
-			++this_info;
-			// kind of hack-y...
-			if(this_info == info_end)
-				break;
+			u16 const entry { make_rle_tile(info, tile_base) };
+			while(this_chr + runlength < end &&
+						infolist[this_chr + runlength].type != BLANK &&
+						make_rle_tile(infolist[this_chr + runlength], tile_base) == entry &&
+						runlength < RLE_MAX_TILE_RUN)
+				++runlength;
+
+			// a full run of the last tile flipped both ways would come out as the
+			// terminator, so leave the last one for the next entry
+			if(runlength == RLE_MAX_TILE_RUN &&
+				 (entry | (runlength << RLE_RUN_SHIFT)) == RLE_TERMINATOR)
+				--runlength;
+
+			tilemap.push_back(runlength > 1 ? entry | (runlength << RLE_RUN_SHIFT)
+																			: entry);
 		}
 
-		// at this point, we should have accounted for a tile run
-		auto tilemapEntry =
-				make_chirari_rle_entry(*info_prev, tile_base, runlength);
-		outTilemap.push_back(tilemapEntry);
+		this_chr += runlength;
+	}
 
-		// prepare for next check
-		runlength = 1;
-		info_prev = this_info;
+	tilemap.push_back(RLE_TERMINATOR);
 
-		//} while (++thisTile != infoEnd);
-	} while(++this_info != info_end);
+#ifdef DEBUG
+	check_rle_tilemap(tilemap, infolist, index, length, tile_base);
+#endif
 
-	// and account for the very last tile
-	auto tilemapEntry = make_chirari_rle_entry(*info_prev, tile_base, runlength);
-	outTilemap.push_back(tilemapEntry);
+	return tilemap;
+}
 
-	// map terminator
-	outTilemap.push_back(0xffff);
+RleTilemap decode_rle_tilemap(vector<u16> const & tilemap)
+{
+	if(tilemap.empty())
+		throw runtime_error("RLE tilemap is missing its width");
+
+	RleTilemap decoded;
+	decoded.width = tilemap[0];
+
+	for(size_t this_word { 1 };; ++this_word)
+	{
+		if(this_word == tilemap.size())
+			throw runtime_error("RLE tilemap is missing its terminator");
+		u16 const word { tilemap[this_word] };
+		if(word == RLE_TERMINATOR)
+			break;
+
+		TilemapEntry entry;
+		u16 const run_bits = word >> RLE_RUN_SHIFT;
+		if(run_bits == (RLE_BLANK_RUN >> RLE_RUN_SHIFT))
+		{
+			if((word & RLE_ENTRY_MASK) == 0)
+				throw runtime_error("RLE tilemap has an empty blank run at word " +
+														to_string(this_word));
+			entry.runlength = word & RLE_ENTRY_MASK;
+		}
+		else
+		{
+			entry.id = word & 0x7ff;
+			entry.h_flip = (word & 0x800) != 0;
+			entry.v_flip = (word & 0x1000) != 0;
+			if(run_bits > 1)
+				entry.runlength = run_bits;
+		}
+		decoded.entries.push_back(entry);
+	}
 
-	return outTilemap;
+	return decoded;
 }
@@ -0,0 +1,267 @@
+#include "tilepool.hpp"
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+// which unique tiles are used in which banks
+struct BankUsage
+{
+	// unique tiles used by each bank, in the order they first appear
+	vector<vector<u32>> bank_tiles;
+	// banks in which each unique tile is used, in order
+	vector<vector<size_t>> tile_banks;
+
+	BankUsage(TileAnalysis const & analysis, size_t const bank_size);
+
+	size_t bank_count() const
+	{
+		return bank_tiles.size();
+	}
+
+	// throws if any bank uses more unique tiles than the given limit
+	void check_fit(size_t const limit, char const * limit_name) const;
+};
+
+BankUsage::BankUsage(TileAnalysis const & analysis, size_t const bank_size)
+{
+	auto const & infolist { analysis.infolist };
+	size_t const bank_count { bank_size > 0 ? infolist.size() / bank_size : 0 };
+
+	bank_tiles.resize(bank_count);
+	tile_banks.resize(analysis.chrs.size());
+	for(size_t bankidx { 0 }; bankidx < bank_count; ++bankidx)
+	{
+		size_t const bank_end { bank_size * (bankidx + 1) };
+		for(size_t this_chr { bank_size * bankidx }; this_chr < bank_end;
+				++this_chr)
+		{
+			auto const & tileinfo { infolist[this_chr] };
+			if(tileinfo.type == BLANK)
+				continue;
+			auto & banks { tile_banks[tileinfo.idx_opt] };
+			if(!banks.empty() && banks.back() == bankidx)
+				continue;
+			banks.push_back(bankidx);
+			bank_tiles[bankidx].push_back(tileinfo.idx_opt);
+		}
+	}
+}
+
+void BankUsage::check_fit(size_t const limit, char const * limit_name) const
+{
+	for(size_t bankidx { 0 }; bankidx < bank_count(); ++bankidx)
+	{
+		if(bank_tiles[bankidx].size() > limit)
+		{
+			stringstream ss;
+			ss << "Bank " << bankidx << " uses " << bank_tiles[bankidx].size()
+				 << " unique tiles, which is over the " << limit_name << " of "
+				 << limit;
+			throw runtime_error(ss.str());
+		}
+	}
+}
+
+// copies the map entry info for one bank, pointing each tile to its new index
+vector<TileOptInfo> remap_bank(TileAnalysis const & analysis,
+															 size_t const bank_size, size_t const bankidx,
+															 vector<u32> const & new_idx)
+{
+	vector<TileOptInfo> bank_infolist(
+			analysis.infolist.begin() + (bank_size * bankidx),
+			analysis.infolist.begin() + (bank_size * (bankidx + 1)));
+	for(auto & tileinfo : bank_infolist)
+		if(tileinfo.type != BLANK)
+			tileinfo.idx_opt = new_idx[tileinfo.idx_opt];
+	return bank_infolist;
+}
+} // namespace
+
+TilePool make_tile_pool(TileAnalysis const & analysis, size_t const bank_size,
+												size_t const vram_budget)
+{
+	size_t const unique_count { analysis.chrs.size() };
+	BankUsage const usage { analysis, bank_size };
+	auto const & bank_tiles { usage.bank_tiles };
+	auto const & tile_banks { usage.tile_banks };
+	size_t const bank_count { usage.bank_count() };
+
+	// with nothing resident, each bank still has to fit on its own
+	usage.check_fit(vram_budget, "VRAM budget");
+	vector<size_t> remaining(bank_count);
+	for(size_t bankidx { 0 }; bankidx < bank_count; ++bankidx)
+		remaining[bankidx] = bank_tiles[bankidx].size();
+
+	// the more banks a tile is used in, the more is saved by keeping it resident
+	// (tiles past the last full bank aren't used at all and are dropped)
+	vector<u32> candidates;
+	for(size_t this_tile { 0 }; this_tile < unique_count; ++this_tile)
+		if(!tile_banks[this_tile].empty())
+			candidates.push_back(this_tile);
+	stable_sort(candidates.begin(), candidates.end(), [&](u32 a, u32 b) {
+		return tile_banks[a].size() > tile_banks[b].size();
+	});
+
+	// a resident tile takes up a slot in every bank, but frees one up in each
+	// bank that uses it; keep it only if the largest bank still fits
+	vector<bool> is_resident(unique_count, false);
+	size_t resident_count { 0 };
+	for(auto const this_tile : candidates)
+	{
+		for(auto const bankidx : tile_banks[this_tile])
+			--remaining[bankidx];
+
+		size_t const largest_bank { *max_element(remaining.begin(),
+																						 remaining.end()) };
+		if(resident_count + 1 + largest_bank <= vram_budget)
+		{
+			is_resident[this_tile] = true;
+			++resident_count;
+		}
+		else
+		{
+			for(auto const bankidx : tile_banks[this_tile])
+				++remaining[bankidx];
+		}
+	}
+
+	TilePool pool;
+
+	// final index of each unique tile, either in the resident set (which keeps
+	// the original order) or in the current bank
+	vector<u32> pool_idx(unique_count);
+	for(size_t this_tile { 0 }; this_tile < unique_count; ++this_tile)
+	{
+		if(!is_resident[this_tile])
+			continue;
+		pool_idx[this_tile] = pool.resident.size();
+		pool.resident.push_back(analysis.chrs[this_tile]);
+	}
+
+	pool.bank_chrs.resize(bank_count);
+	pool.bank_infolists.resize(bank_count);
+	for(size_t bankidx { 0 }; bankidx < bank_count; ++bankidx)
+	{
+		auto & bank_chrs { pool.bank_chrs[bankidx] };
+		for(auto const this_tile : bank_tiles[bankidx])
+		{
+			if(is_resident[this_tile])
+				continue;
+			pool_idx[this_tile] = resident_count + bank_chrs.size();
+			bank_chrs.push_back(analysis.chrs[this_tile]);
+		}
+
+		pool.bank_infolists[bankidx] =
+				remap_bank(analysis, bank_size, bankidx, pool_idx);
+	}
+
+	return pool;
+}
+
+FrameDeltas make_frame_deltas(TileAnalysis const & analysis,
+															size_t const frame_size, size_t const slot_count)
+{
+	size_t const unique_count { analysis.chrs.size() };
+	BankUsage const usage { analysis, frame_size };
+	auto const & frame_tiles { usage.bank_tiles };
+	auto const & tile_frames { usage.tile_banks };
+	size_t const frame_count { usage.bank_count() };
+
+	usage.check_fit(slot_count, "slot count");
+
+	FrameDeltas deltas;
+
+	// tiles that aren't used by any frame (i.e. past the last full frame) are
+	// dropped from the upload source
+	vector<u32> source_idx(unique_count);
+	for(size_t this_tile { 0 }; this_tile < unique_count; ++this_tile)
+	{
+		if(tile_frames[this_tile].empty())
+			continue;
+		source_idx[this_tile] = deltas.chrs.size();
+		deltas.chrs.push_back(analysis.chrs[this_tile]);
+	}
+
+	// every frame needs all its tiles in the slots, so the only choice is which
+	// tile to replace when a new one comes in
+	// replacing the tile whose next use is the furthest away (or which is never
+	// used again) is optimal when all uploads cost the same, as is the case for
+	// tiles; this is Belady's algorithm, as used for page replacement
+	size_t const never { numeric_limits<size_t>::max() };
+	size_t const empty { numeric_limits<size_t>::max() };
+	vector<size_t> slot_tiles(slot_count, empty);
+	vector<size_t> tile_slots(unique_count, empty);
+	// the last frame each tile is needed by, so tiles needed in the current
+	// frame aren't replaced
+	vector<size_t> last_needed(unique_count, never);
+
+	deltas.uploads.resize(frame_count);
+	deltas.frame_infolists.resize(frame_count);
+
+	vector<u32> frame_slots(unique_count);
+	for(size_t frameidx { 0 }; frameidx < frame_count; ++frameidx)
+	{
+		for(auto const this_tile : frame_tiles[frameidx])
+			last_needed[this_tile] = frameidx;
+
+		auto & uploads { deltas.uploads[frameidx] };
+		for(auto const this_tile : frame_tiles[frameidx])
+		{
+			if(tile_slots[this_tile] != empty)
+			{
+				frame_slots[this_tile] = tile_slots[this_tile];
+				continue;
+			}
+
+			// use an empty slot if there is one, otherwise the slot whose tile is
+			// needed again the furthest in the future
+			// (ties go to the lowest slot so the result is always the same)
+			size_t best_slot { empty };
+			size_t best_next_use { 0 };
+			for(size_t this_slot { 0 }; this_slot < slot_count; ++this_slot)
+			{
+				size_t const slot_tile { slot_tiles[this_slot] };
+				if(slot_tile == empty)
+				{
+					best_slot = this_slot;
+					break;
+				}
+				if(last_needed[slot_tile] == frameidx)
+					continue;
+
+				auto const & frames { tile_frames[slot_tile] };
+				auto const i_next { upper_bound(frames.begin(), frames.end(),
+																				frameidx) };
+				size_t const next_use { i_next == frames.end() ? never : *i_next };
+				if(best_slot == empty || next_use > best_next_use)
+				{
+					best_slot = this_slot;
+					best_next_use = next_use;
+				}
+			}
+
+			// (can't fail, since the frame itself fits in the slots)
+			if(slot_tiles[best_slot] != empty)
+				tile_slots[slot_tiles[best_slot]] = empty;
+			slot_tiles[best_slot] = this_tile;
+			tile_slots[this_tile] = best_slot;
+			frame_slots[this_tile] = best_slot;
+			uploads.push_back(TileUpload { (u32)best_slot, source_idx[this_tile] });
+		}
+
+		sort(uploads.begin(), uploads.end(),
+				 [](TileUpload const & a, TileUpload const & b) {
+					 return a.slot < b.slot;
+				 });
+
+		deltas.frame_infolists[frameidx] =
+				remap_bank(analysis, frame_size, frameidx, frame_slots);
+	}
+
+	return deltas;
+}
@@ -0,0 +1,65 @@
+#include "tileview.hpp"
+
+using namespace std;
+using namespace png;
+
+// we read index pixels as plain bytes
+static_assert(sizeof(index_pixel) == 1, "index_pixel is not a single byte");
+
+TileView::TileView(pixel_buffer<index_pixel> const & pixbuf) :
+		m_width_chr(pixbuf.get_width() / BASIC_CHR_WIDTH),
+		m_height_chr(pixbuf.get_height() / BASIC_CHR_HEIGHT)
+{
+	m_rows.reserve(m_height_chr * BASIC_CHR_HEIGHT);
+	for(size_t this_row { 0 }; this_row < m_height_chr * BASIC_CHR_HEIGHT;
+			++this_row)
+		m_rows.push_back((byte_t const *)pixbuf.get_row(this_row).data());
+}
+
+TileView::TileView(vector<byte_t const *> const & rows, size_t width) :
+		m_rows(rows), m_width_chr(width / BASIC_CHR_WIDTH),
+		m_height_chr(rows.size() / BASIC_CHR_HEIGHT)
+{
+}
+
+size_t TileView::width() const
+{
+	return m_width_chr;
+}
+
+size_t TileView::height() const
+{
+	return m_height_chr;
+}
+
+size_t TileView::size() const
+{
+	return m_width_chr * m_height_chr;
+}
+
+void TileView::get_basic(size_t chr_idx, byte_t * out) const
+{
+	auto i_row { m_rows.begin() + ((chr_idx / m_width_chr) * BASIC_CHR_HEIGHT) };
+	size_t const col_offset { (chr_idx % m_width_chr) * BASIC_CHR_WIDTH };
+	for(u8 this_row { 0 }; this_row < BASIC_CHR_HEIGHT; ++this_row, ++i_row)
+	{
+		copy(*i_row + col_offset, *i_row + col_offset + BASIC_CHR_WIDTH, out);
+		out += BASIC_CHR_WIDTH;
+	}
+}
+
+PackedChr TileView::get_packed(size_t chr_idx) const
+{
+	PackedChr out;
+	auto i_row { m_rows.begin() + ((chr_idx / m_width_chr) * BASIC_CHR_HEIGHT) };
+	size_t const col_offset { (chr_idx % m_width_chr) * BASIC_CHR_WIDTH };
+	for(auto & out_row : out.rows)
+	{
+		byte_t const * pxl { *i_row++ + col_offset };
+		u32 row { 0 };
+		for(u8 this_pxl { 0 }; this_pxl < BASIC_CHR_WIDTH; ++this_pxl)
+			row = (row << 4) | (*pxl++ & 0xf);
+		out_row = row;
+	}
+	return out;
+}
@@ -0,0 +1,103 @@
+// checks that analyze() gives exactly the same result whatever the number of
+// threads it's split across
+
+#include "gfxutils.hpp"
+#include "tileopt.hpp"
+#include "tileview.hpp"
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+constexpr size_t MAX_THREADS { 8 };
+// (big enough to be split into a shard for every thread)
+constexpr size_t WIDTH_CHR { 256 };
+constexpr size_t HEIGHT_CHR { MIN_SHARD_SIZE * MAX_THREADS / WIDTH_CHR };
+
+// an image made up of a limited set of tiles, placed with random flips, so
+// there are plenty of duplicates (flipped and not) alongside blank and flat
+// tiles
+vector<byte_t> make_image(mt19937 & rng)
+{
+	vector<PackedChr> sources(300);
+	for(size_t this_source { 0 }; this_source < sources.size(); ++this_source)
+	{
+		u32 const flatrow { (u32)(rng() % 16) * 0x11111111 };
+		for(auto & row : sources[this_source].rows)
+			row = this_source % 10 == 0 ? flatrow : (u32)rng();
+	}
+
+	size_t const width { WIDTH_CHR * BASIC_CHR_WIDTH };
+	vector<byte_t> pixels(width * HEIGHT_CHR * BASIC_CHR_HEIGHT);
+	for(size_t this_chr { 0 }; this_chr < WIDTH_CHR * HEIGHT_CHR; ++this_chr)
+	{
+		PackedChr chr { sources[rng() % sources.size()] };
+		if(rng() % 2)
+			h_flip_tile(chr);
+		if(rng() % 2)
+			v_flip_tile(chr);
+
+		size_t const x { (this_chr % WIDTH_CHR) * BASIC_CHR_WIDTH },
+				y { (this_chr / WIDTH_CHR) * BASIC_CHR_HEIGHT };
+		for(size_t this_row { 0 }; this_row < BASIC_CHR_HEIGHT; ++this_row)
+			for(size_t this_pxl { 0 }; this_pxl < BASIC_CHR_WIDTH; ++this_pxl)
+				pixels[(y + this_row) * width + x + this_pxl] =
+						(chr.rows[this_row] >> (28 - this_pxl * 4)) & 0xf;
+	}
+	return pixels;
+}
+} // namespace
+
+int main()
+{
+	mt19937 rng { 1 };
+	auto const pixels { make_image(rng) };
+	size_t const width { WIDTH_CHR * BASIC_CHR_WIDTH };
+	vector<byte_t const *> rows;
+	for(size_t this_row { 0 }; this_row < HEIGHT_CHR * BASIC_CHR_HEIGHT;
+			++this_row)
+		rows.push_back(pixels.data() + this_row * width);
+	TileView const tiles { rows, width };
+
+	auto const expected { analyze(tiles, 0, tiles.size(), 1) };
+	size_t failures { 0 };
+	for(size_t threads { 2 }; threads <= MAX_THREADS; ++threads)
+	{
+		auto const result { analyze(tiles, 0, tiles.size(), threads) };
+
+		for(size_t this_chr { 0 }; this_chr < tiles.size(); ++this_chr)
+		{
+			auto const & want { expected.infolist[this_chr] };
+			auto const & got { result.infolist[this_chr] };
+			if(got.type != want.type || got.idx_opt != want.idx_opt ||
+				 got.dupe_of_idx != want.dupe_of_idx || got.h_flip != want.h_flip ||
+				 got.v_flip != want.v_flip)
+			{
+				if(failures++ < 20)
+					cerr << threads << " threads: tile " << this_chr
+							 << " does not match the single thread result" << endl;
+			}
+		}
+
+		bool same_chrs { result.chrs.size() == expected.chrs.size() };
+		for(size_t this_chr { 0 }; same_chrs && this_chr < result.chrs.size();
+				++this_chr)
+			same_chrs = is_identical_tile(result.chrs[this_chr],
+																		expected.chrs[this_chr]);
+		if(!same_chrs)
+		{
+			++failures;
+			cerr << threads << " threads: unique tiles do not match" << endl;
+		}
+	}
+
+	if(failures > 0)
+	{
+		cerr << failures << " mismatches" << endl;
+		return 1;
+	}
+	return 0;
+}
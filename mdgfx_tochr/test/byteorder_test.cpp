@@ -0,0 +1,51 @@
+// checks that every SIMD version of the word swap gives the same results as
+// the scalar version
+
+#include "byteorder.hpp"
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+int main()
+{
+	mt19937 rng { 1 };
+	auto const swaps { available_word_swaps() };
+	auto const & scalar { swaps.front() };
+
+	size_t failures { 0 };
+	for(auto const & test : swaps)
+	{
+		cout << "checking " << test.name << endl;
+		// every length up to a few registers, to cover the tails
+		for(size_t count { 0 }; count < 100; ++count)
+		{
+			vector<u16> expected(count), result;
+			for(auto & word : expected)
+				word = (u16)rng();
+			result = expected;
+			scalar.swap_words(expected.data(), count);
+			test.swap_words(result.data(), count);
+			if(expected != result && failures++ < 20)
+				cerr << test.name << " swap_words does not match scalar for " << count
+						 << " words" << endl;
+		}
+	}
+
+	// and the swap itself, which the scalar version is trusted for above
+	vector<u16> words { 0x1234, 0xabcd };
+	scalar.swap_words(words.data(), words.size());
+	if(words[0] != 0x3412 || words[1] != 0xcdab)
+	{
+		cerr << "scalar swap_words does not swap the bytes" << endl;
+		++failures;
+	}
+
+	if(failures > 0)
+	{
+		cerr << failures << " mismatches" << endl;
+		return 1;
+	}
+	return 0;
+}
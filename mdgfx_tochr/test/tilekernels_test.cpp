@@ -0,0 +1,102 @@
+// checks that every SIMD version of the packed tile functions gives the same
+// results as the scalar versions
+
+#include "tilekernels.hpp"
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+// random tiles, with plenty of blank, flat and nearly flat ones, since those
+// are the edge cases for the predicates
+vector<PackedChr> make_tiles(mt19937 & rng, size_t const count)
+{
+	vector<PackedChr> tiles(count);
+	for(auto & chr : tiles)
+	{
+		u32 const flatrow { (u32)(rng() % 16) * 0x11111111 };
+		switch(rng() % 4)
+		{
+			case 0:
+				memset(chr.rows, 0, PACKED_CHR_BYTESZ);
+				break;
+			case 1:
+				for(auto & row : chr.rows)
+					row = flatrow;
+				break;
+			case 2:
+				for(auto & row : chr.rows)
+					row = flatrow;
+				chr.rows[rng() % 8] ^= 1 << (rng() % 32);
+				break;
+			default:
+				for(auto & row : chr.rows)
+					row = (u32)rng();
+				break;
+		}
+	}
+	return tiles;
+}
+
+bool same_tile(PackedChr const & chr1, PackedChr const & chr2)
+{
+	return memcmp(chr1.rows, chr2.rows, PACKED_CHR_BYTESZ) == 0;
+}
+} // namespace
+
+int main()
+{
+	mt19937 rng { 1 };
+	auto const kernels { available_kernels() };
+	auto const & scalar { kernels.front() };
+	auto const tiles { make_tiles(rng, 10000) };
+
+	size_t failures { 0 };
+	auto check = [&](bool ok, TileKernels const & test, char const * what) {
+		if(!ok && failures++ < 20)
+			cerr << test.name << ' ' << what << " does not match scalar" << endl;
+	};
+
+	for(auto const & test : kernels)
+	{
+		cout << "checking " << test.name << endl;
+		for(size_t this_tile { 0 }; this_tile < tiles.size(); ++this_tile)
+		{
+			auto const & chr { tiles[this_tile] };
+			// (compare against the next tile and, every so often, itself)
+			auto const & other { this_tile % 5 == 0
+															 ? chr
+															 : tiles[(this_tile + 1) % tiles.size()] };
+
+			check(test.is_blank_tile(chr) == scalar.is_blank_tile(chr), test,
+						"is_blank_tile");
+			check(test.is_flat_tile(chr) == scalar.is_flat_tile(chr), test,
+						"is_flat_tile");
+			check(test.is_identical_tile(chr, other) ==
+								scalar.is_identical_tile(chr, other),
+						test, "is_identical_tile");
+
+			PackedChr expected { chr }, result { chr };
+			scalar.v_flip_tile(expected);
+			test.v_flip_tile(result);
+			check(same_tile(expected, result), test, "v_flip_tile");
+
+			expected = chr;
+			result = chr;
+			scalar.h_flip_tile(expected);
+			test.h_flip_tile(result);
+			check(same_tile(expected, result), test, "h_flip_tile");
+		}
+	}
+
+	if(failures > 0)
+	{
+		cerr << failures << " mismatches" << endl;
+		return 1;
+	}
+	return 0;
+}